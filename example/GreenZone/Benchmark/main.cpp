@@ -0,0 +1,668 @@
+/*
+ * main.cpp
+ *
+ * Throughput benchmarks. Usage: Benchmark <name> [options]
+ * Define GREENZONE_WITH_ZLIB (and link zlib) for the gzip benchmark.
+ */
+
+#include <Context/Context.hpp>
+#include <Context/FastParser.hpp>
+#include <IO/Escape.hpp>
+#include <IO/FileWriter.hpp>
+#ifdef GREENZONE_WITH_ZLIB
+#include <IO/GzipWriter.hpp>
+#endif
+#include <IO/RopeWriter.hpp>
+#include <IO/StringReader.hpp>
+#include <Template/Template.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	class StringTemplate : public GreenZone::Template
+	{
+	public:
+		StringTemplate(std::string const & source, GreenZone::Parser const & parser = GreenZone::Parser())
+		{
+			GreenZone::StringReader reader(source);
+			loadFromStream(&reader, parser);
+		}
+	};
+
+	std::string const pageSource =
+		"<html><head><title>{{ title }}</title></head><body>\n"
+		"<table>\n"
+		"{% for row in rows %}"
+		"  <tr class=\"{% if row.active %}active{% else %}inactive{% endif %}\">"
+		"<td>{{ row.id }}</td><td>{{ row.name }}</td><td>{{ row.price * row.count }}</td></tr>\n"
+		"{% endfor %}"
+		"</table>\n"
+		"<p>{{ length(rows) }} rows, generated for {{ user.name }}</p>\n"
+		"</body></html>\n";
+
+	json11::Json pageContext(int rows)
+	{
+		json11::Json::array items;
+		for (int i = 0; i < rows; ++i)
+		{
+			items.push_back(json11::Json::object{
+				{ "id", i },
+				{ "name", "Item #" + std::to_string(i) },
+				{ "price", 0.25 * i },
+				{ "count", i % 7 },
+				{ "active", i % 3 == 0 },
+			});
+		}
+		return json11::Json::object{
+			{ "title", "Benchmark page" },
+			{ "rows", items },
+			{ "user", json11::Json::object{ { "name", "benchmark" } } },
+		};
+	}
+
+	double seconds(Clock::duration duration)
+	{
+		return std::chrono::duration_cast< std::chrono::duration< double > >(duration).count();
+	}
+
+	// One compiled template rendered concurrently by 1, 2, 4 ... N threads.
+	// Options: [max threads] [seconds per step] [rows]
+	int concurrentRender(std::vector< std::string > const & args)
+	{
+		unsigned maxThreads = args.size() > 0 ? std::stoul(args[0]) : std::max(1u, std::thread::hardware_concurrency());
+		double duration = args.size() > 1 ? std::stod(args[1]) : 2.0;
+		int rows = args.size() > 2 ? std::stoi(args[2]) : 100;
+
+		StringTemplate tpl(pageSource);
+		json11::Json json = pageContext(rows);
+		size_t pageSize = 0;
+		{
+			GreenZone::Context context(json);
+			pageSize = tpl.render(&context).size();
+		}
+		std::cout << "page: " << pageSize << " bytes, " << rows << " rows" << std::endl;
+		std::cout << "threads\trenders/s\tMB/s\tspeedup" << std::endl;
+
+		std::vector< unsigned > steps;
+		for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+		{
+			steps.push_back(threads);
+		}
+		steps.push_back(maxThreads);
+
+		double single = 0;
+		for (unsigned threads : steps)
+		{
+			std::atomic< bool > stop(false);
+			std::atomic< size_t > renders(0);
+			std::vector< std::thread > workers;
+			auto start = Clock::now();
+			for (unsigned i = 0; i < threads; ++i)
+			{
+				workers.emplace_back([&]()
+				{
+					GreenZone::Context context(json);
+					size_t local = 0;
+					while (!stop.load(std::memory_order_relaxed))
+					{
+						tpl.render(&context);
+						++local;
+					}
+					renders += local;
+				});
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(int(duration * 1000)));
+			stop = true;
+			for (auto & worker : workers)
+			{
+				worker.join();
+			}
+			double rate = renders / seconds(Clock::now() - start);
+			if (threads == 1)
+			{
+				single = rate;
+			}
+			std::cout << threads << "\t" << size_t(rate) << "\t\t" << rate * pageSize / (1 << 20)
+				<< "\t" << rate / single << std::endl;
+		}
+		return 0;
+	}
+
+	// Template::renderBatch over many contexts.
+	// Options: [contexts] [threads] [ordered (1/0)] [rows]
+	int batchRender(std::vector< std::string > const & args)
+	{
+		size_t count = args.size() > 0 ? std::stoul(args[0]) : 20000;
+		size_t threads = args.size() > 1 ? std::stoul(args[1]) : 0;
+		bool ordered = args.size() > 2 ? args[2] != "0" : true;
+		int rows = args.size() > 3 ? std::stoi(args[3]) : 20;
+
+		StringTemplate tpl(pageSource);
+		json11::Json json = pageContext(rows);
+		std::vector< GreenZone::Context > contexts(count, GreenZone::Context(json));
+
+		GreenZone::ThreadPool pool(threads);
+		GreenZone::Template::BatchOptions options;
+		options.pool = &pool;
+		options.ordered = ordered;
+		size_t checksum = 0;
+		GreenZone::Template::BatchStats stats = tpl.renderBatch(contexts.begin(), contexts.end(),
+			[&](size_t, std::string const & output) { checksum += output.size(); }, options);
+
+		std::cout << "threads: " << pool.size() << (ordered ? ", ordered" : ", as completed") << std::endl;
+		std::cout << stats.renders << " renders in " << stats.seconds << " s: "
+			<< size_t(stats.rendersPerSecond()) << " renders/s, "
+			<< stats.bytesPerSecond() / (1 << 20) << " MB/s" << std::endl;
+		return checksum == stats.bytes ? 0 : 1;
+	}
+
+	// One large page rendered sequentially, then with its loop split over ThreadPool::shared().
+	// Options: [rows] [parallel threshold] [renders]
+	int parallelLoop(std::vector< std::string > const & args)
+	{
+		int rows = args.size() > 0 ? std::stoi(args[0]) : 100000;
+		size_t threshold = args.size() > 1 ? std::stoul(args[1]) : 1000;
+		int renders = args.size() > 2 ? std::stoi(args[2]) : 5;
+
+		GreenZone::Context context(pageContext(rows));
+		std::cout << "threads: " << GreenZone::ThreadPool::shared().size() << ", " << rows << " rows" << std::endl;
+
+		std::string reference;
+		for (size_t step : { size_t(0), threshold })
+		{
+			GreenZone::Parser parser;
+			parser.setParallelThreshold(step);
+			StringTemplate tpl(pageSource, parser);
+			std::string output;
+			auto start = Clock::now();
+			for (int i = 0; i < renders; ++i)
+			{
+				tpl.render(&context, output);
+			}
+			double elapsed = seconds(Clock::now() - start);
+			std::cout << (step ? "parallel" : "sequential") << ": " << elapsed / renders * 1000 << " ms/render, "
+				<< renders * output.size() / elapsed / (1 << 20) << " MB/s" << std::endl;
+			if (!step)
+			{
+				reference.swap(output);
+			}
+			else if (output != reference)
+			{
+				std::cerr << "parallel output differs" << std::endl;
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	// Static-heavy page written to /dev/null, rendered into a string and into a RopeWriter.
+	// Options: [renders] [rows]
+	int ropeRender(std::vector< std::string > const & args)
+	{
+		int renders = args.size() > 0 ? std::stoi(args[0]) : 2000;
+		int rows = args.size() > 1 ? std::stoi(args[1]) : 50;
+
+		std::string const boilerplate(2048, '#');
+		StringTemplate tpl("<html><head><style>" + boilerplate + "</style></head><body>\n"
+			"{% for row in rows %}<div class=\"row\"><span class=\"id\">{{ row.id }}</span>"
+			"<span class=\"label\">A static label that is the same for every single row</span></div>\n{% endfor %}"
+			"<footer>" + boilerplate + "</footer></body></html>\n");
+		GreenZone::Context context(pageContext(rows));
+		int fd = ::open("/dev/null", O_WRONLY);
+		if (fd < 0)
+		{
+			std::cerr << "Can not open /dev/null" << std::endl;
+			return 1;
+		}
+
+		std::string output;
+		auto start = Clock::now();
+		for (int i = 0; i < renders; ++i)
+		{
+			tpl.render(&context, output);
+			if (::write(fd, output.data(), output.size()) < 0)
+			{
+				return 1;
+			}
+		}
+		double stringSeconds = seconds(Clock::now() - start);
+
+		GreenZone::RopeWriter rope;
+		start = Clock::now();
+		for (int i = 0; i < renders; ++i)
+		{
+			rope.clear();
+			tpl.renderToStream(&rope, &context);
+			rope.flushTo(fd);
+		}
+		double ropeSeconds = seconds(Clock::now() - start);
+		::close(fd);
+
+		std::cout << "page: " << output.size() << " bytes, " << rope.slices().size() << " slices" << std::endl;
+		std::cout << "string: " << renders / stringSeconds << " renders/s" << std::endl;
+		std::cout << "rope:   " << renders / ropeSeconds << " renders/s" << std::endl;
+		return rope.size() == output.size() ? 0 : 1;
+	}
+
+	// FileWriter throughput with synchronous and background flushes. A rendered page is
+	// written over and over, rendering itself is measured by the other benchmarks.
+	// Options: [megabytes] [buffer KB] [file ...] (defaults to one file on tmpfs and one
+	// in the current directory)
+	int fileWrite(std::vector< std::string > const & args)
+	{
+		size_t megabytes = args.size() > 0 ? std::stoul(args[0]) : 512;
+		size_t bufferSize = (args.size() > 1 ? std::stoul(args[1]) : 1024) * 1024;
+		std::vector< std::string > files(args.size() > 2 ? args.begin() + 2 : args.end(), args.end());
+		if (files.empty())
+		{
+			files.push_back("/dev/shm/greenzone-benchmark.out");
+			files.push_back("greenzone-benchmark.out");
+		}
+
+		StringTemplate tpl(pageSource);
+		GreenZone::Context context(pageContext(100));
+		std::string const page = tpl.render(&context);
+		size_t pageSize = page.size();
+		size_t renders = megabytes * (1 << 20) / pageSize + 1;
+
+		std::cout << "file\tflush\tGB/s" << std::endl;
+		for (auto const & file : files)
+		{
+			for (bool async : { false, true })
+			{
+				auto start = Clock::now();
+				{
+					GreenZone::FileWriter writer(file, bufferSize, async);
+					for (size_t i = 0; i < renders; ++i)
+					{
+						writer.write(page);
+					}
+					writer.close();
+				}
+				double elapsed = seconds(Clock::now() - start);
+				std::cout << file << "\t" << (async ? "async" : "sync") << "\t"
+					<< renders * pageSize / elapsed / (1 << 30) << std::endl;
+			}
+			std::remove(file.c_str());
+		}
+		return 0;
+	}
+
+	// Large page rendered into a fresh string per render and into pooled, pre-sized buffers.
+	// Options: [renders] [rows]
+	int pooledRender(std::vector< std::string > const & args)
+	{
+		int renders = args.size() > 0 ? std::stoi(args[0]) : 200;
+		int rows = args.size() > 1 ? std::stoi(args[1]) : 1500;
+
+		StringTemplate tpl(pageSource);
+		GreenZone::Context context(pageContext(rows));
+		size_t bytes = 0;
+
+		auto start = Clock::now();
+		for (int i = 0; i < renders; ++i)
+		{
+			std::string output;
+			GreenZone::StringWriter writer(output);
+			tpl.root()->render(&writer, &context);
+			bytes += output.size();
+		}
+		double freshSeconds = seconds(Clock::now() - start);
+
+		start = Clock::now();
+		for (int i = 0; i < renders; ++i)
+		{
+			GreenZone::PooledString output = tpl.renderPooled(&context);
+			bytes -= output.size();
+		}
+		double pooledSeconds = seconds(Clock::now() - start);
+
+		std::cout << "page: ~" << tpl.outputSizeHint() << " bytes reserved" << std::endl;
+		std::cout << "fresh string: " << renders / freshSeconds << " renders/s" << std::endl;
+		std::cout << "pooled:       " << renders / pooledSeconds << " renders/s" << std::endl;
+		return bytes ? 1 : 0;
+	}
+
+	// Escaper throughput on text with one special character every [spacing] bytes.
+	// Options: [megabytes] [spacing]
+	int escape(std::vector< std::string > const & args)
+	{
+		size_t megabytes = args.size() > 0 ? std::stoul(args[0]) : 256;
+		size_t spacing = args.size() > 1 ? std::stoul(args[1]) : 64;
+
+		std::string text(1 << 20, 'x');
+		for (size_t i = spacing; i < text.size(); i += spacing)
+		{
+			text[i] = "<&\"' "[i / spacing % 5];
+		}
+		std::pair< char const *, GreenZone::EscapeMode > const modes[] = {
+			std::make_pair("html", GreenZone::EscapeMode::Html),
+			std::make_pair("attribute", GreenZone::EscapeMode::Attribute),
+			std::make_pair("js", GreenZone::EscapeMode::Js),
+			std::make_pair("url", GreenZone::EscapeMode::Url),
+		};
+		std::string output;
+		for (auto const & mode : modes)
+		{
+			auto start = Clock::now();
+			for (size_t i = 0; i < megabytes; ++i)
+			{
+				output.clear();
+				GreenZone::StringWriter writer(output);
+				GreenZone::Escaper::write(&writer, mode.second, text.data(), text.size());
+			}
+			std::cout << mode.first << ": " << megabytes / seconds(Clock::now() - start) << " MB/s" << std::endl;
+		}
+		return 0;
+	}
+
+	// Formatting of integers and fractional numbers, and a page of numeric cells.
+	// Options: [millions of numbers] [renders]
+	int numbers(std::vector< std::string > const & args)
+	{
+		size_t count = (args.size() > 0 ? std::stoul(args[0]) : 10) * 1000000;
+		int renders = args.size() > 1 ? std::stoi(args[1]) : 200;
+
+		char buffer[GreenZone::NumberBufferSize];
+		size_t bytes = 0;
+		for (double step : { 1.0, 0.37 })
+		{
+			auto start = Clock::now();
+			for (size_t i = 0; i < count; ++i)
+			{
+				bytes += GreenZone::formatNumber(step * i, buffer);
+			}
+			std::cout << (step == 1.0 ? "integers:  " : "fractions: ") << count / seconds(Clock::now() - start) / 1e6
+				<< " M numbers/s" << std::endl;
+		}
+
+		std::string source = "<table>{% for row in rows %}<tr>";
+		for (int i = 0; i < 10; ++i)
+		{
+			source += "<td>{{ row.price * " + std::to_string(i) + " }}</td><td>{{ row.id + " + std::to_string(i) + " }}</td>";
+		}
+		source += "</tr>{% endfor %}</table>";
+		StringTemplate tpl(source);
+		GreenZone::Context context(pageContext(500));
+		std::string output;
+		auto start = Clock::now();
+		for (int i = 0; i < renders; ++i)
+		{
+			tpl.render(&context, output);
+		}
+		std::cout << "table:     " << renders / seconds(Clock::now() - start) << " renders/s" << std::endl;
+		return bytes && output.size() ? 0 : 1;
+	}
+
+	// Parse, render and release a large context: the cost of building and freeing its
+	// values. Options: [iterations] [rows]
+	int parseRenderFree(std::vector< std::string > const & args)
+	{
+		int iterations = args.size() > 0 ? std::stoi(args[0]) : 20;
+		int rows = args.size() > 1 ? std::stoi(args[1]) : 20000;
+
+		StringTemplate tpl(pageSource);
+		std::string const json = pageContext(rows).dump();
+		std::string output;
+		auto start = Clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			GreenZone::Context context(json);
+			tpl.render(&context, output);
+		}
+		std::cout << seconds(Clock::now() - start) / iterations * 1e3
+			<< " ms per parse + render + free of " << json.size() / 1024 << " KB" << std::endl;
+		return output.size() ? 0 : 1;
+	}
+
+	// Lookups in and copies of objects with [members] keys.
+	// Options: [members] [millions of lookups]
+	int objects(std::vector< std::string > const & args)
+	{
+		size_t members = args.size() > 0 ? std::stoul(args[0]) : 32;
+		size_t lookups = (args.size() > 1 ? std::stoul(args[1]) : 10) * 1000000;
+
+		json11::Json::object object;
+		std::vector< std::string > keys;
+		for (size_t i = 0; i < members; ++i)
+		{
+			keys.push_back("member_" + std::to_string(i * 7919 % members));
+			object[keys.back()] = json11::Json(int(i));
+		}
+		json11::Json const json(object);
+		long long sum = 0;
+		auto start = Clock::now();
+		for (size_t i = 0; i < lookups; ++i)
+		{
+			sum += json[keys[i % members]].integer_value();
+		}
+		std::cout << "lookup: " << lookups / seconds(Clock::now() - start) / 1e6 << " M lookups/s" << std::endl;
+
+		size_t copies = lookups / members;
+		start = Clock::now();
+		for (size_t i = 0; i < copies; ++i)
+		{
+			json11::Json::object copy = json.object_items();
+			sum += copy.size();
+		}
+		std::cout << "copy:   " << copies / seconds(Clock::now() - start) / 1e6 << " M copies/s" << std::endl;
+		return sum ? 0 : 1;
+	}
+
+	// Parse throughput of Json::parse and FastParser on a page context of [rows] rows,
+	// after checking that both parse edge case numbers to the same exact value.
+	// Options: [iterations] [rows]
+	int parse(std::vector< std::string > const & args)
+	{
+		int iterations = args.size() > 0 ? std::stoi(args[0]) : 20;
+		int rows = args.size() > 1 ? std::stoi(args[1]) : 20000;
+
+		std::string const numbers = "[0, -0, 123456789012345678, -123456789012345678, "
+			"1234567890123456789, -1234567890123456789, 9007199254740993, "
+			"9223372036854775807, -9223372036854775808, 9223372036854775808, "
+			"-9223372036854775809, 12345678901234567890, 1.5, -2.5e-3, 1e22, 123456789012345678901234]";
+		std::string numbersErr, fastErr;
+		json11::Json const expected = json11::Json::parse(numbers, numbersErr);
+		json11::Json const fast = json11::FastParser::parse(numbers, fastErr);
+		if (!numbersErr.empty() || !fastErr.empty() || expected.dump() != fast.dump() || expected != fast
+			|| expected[7].integer_value() != std::numeric_limits< long long >::max()
+			|| expected[8].integer_value() != std::numeric_limits< long long >::min()
+			|| expected[4].dump() != "1234567890123456789" || !expected[9].is_number() || expected[9].is_integer())
+		{
+			std::cerr << "parsers differ on numbers: " << expected.dump() << " vs " << fast.dump() << std::endl;
+			return 1;
+		}
+
+		std::string const json = pageContext(rows).dump();
+		std::string err;
+		size_t members = 0;
+		auto run = [&](char const * name, std::function< json11::Json(std::string const &, std::string &) > parse)
+		{
+			auto start = Clock::now();
+			for (int i = 0; i < iterations; ++i)
+			{
+				members += parse(json, err).object_items().size();
+			}
+			std::cout << name << json.size() * double(iterations) / seconds(Clock::now() - start) / (1024 * 1024)
+				<< " MB/s" << std::endl;
+		};
+		run("Json::parse: ", [](std::string const & in, std::string & e) { return json11::Json::parse(in, e); });
+		run("FastParser:  ", [](std::string const & in, std::string & e) { return json11::FastParser::parse(in, e); });
+		return err.empty() && members ? 0 : 1;
+	}
+
+	// Parse and render of a page reading a few values of a large context, with eager and
+	// lazy contexts. Options: [iterations] [rows]
+	int lazy(std::vector< std::string > const & args)
+	{
+		int iterations = args.size() > 0 ? std::stoi(args[0]) : 20;
+		int rows = args.size() > 1 ? std::stoi(args[1]) : 20000;
+
+		StringTemplate tpl("<h1>{{ title }}</h1><p>{{ user.name }}</p>");
+		std::string const json = pageContext(rows).dump();
+		std::string output;
+		for (auto parsing : { GreenZone::Context::Eager, GreenZone::Context::Lazy })
+		{
+			auto start = Clock::now();
+			for (int i = 0; i < iterations; ++i)
+			{
+				GreenZone::Context context(json, parsing);
+				tpl.render(&context, output);
+			}
+			std::cout << (parsing == GreenZone::Context::Lazy ? "lazy:  " : "eager: ")
+				<< seconds(Clock::now() - start) / iterations * 1e3 << " ms per render of "
+				<< json.size() / 1024 << " KB" << std::endl;
+		}
+		return output.size() ? 0 : 1;
+	}
+
+	// Parse and render of a page listing one field of each row, with the whole context and
+	// with the template's projection of it. Options: [iterations] [rows]
+	int projection(std::vector< std::string > const & args)
+	{
+		int iterations = args.size() > 0 ? std::stoi(args[0]) : 20;
+		int rows = args.size() > 1 ? std::stoi(args[1]) : 20000;
+
+		StringTemplate tpl("<h1>{{ title }}</h1><ul>{% for row in rows %}<li>{{ row.name }}</li>{% endfor %}</ul>");
+		std::string const json = pageContext(rows).dump();
+		std::string output;
+		for (bool projected : { false, true })
+		{
+			auto start = Clock::now();
+			for (int i = 0; i < iterations; ++i)
+			{
+				std::unique_ptr< GreenZone::Context > context(projected
+					? new GreenZone::Context(json, tpl.projection()) : new GreenZone::Context(json));
+				tpl.render(context.get(), output);
+			}
+			std::cout << (projected ? "projected: " : "whole:     ") << seconds(Clock::now() - start) / iterations * 1e3
+				<< " ms per render of " << json.size() / 1024 << " KB" << std::endl;
+		}
+		return output.size() ? 0 : 1;
+	}
+
+#ifdef GREENZONE_WITH_ZLIB
+	// CPU time per gzipped response: render then compress, compressing while rendering,
+	// and compressing while rendering with precompressed static text.
+	// Options: [renders] [rows] [level]
+	int gzip(std::vector< std::string > const & args)
+	{
+		int renders = args.size() > 0 ? std::stoi(args[0]) : 500;
+		int rows = args.size() > 1 ? std::stoi(args[1]) : 50;
+		int level = args.size() > 2 ? std::stoi(args[2]) : 6;
+
+		std::string const boilerplate(8192, ' ');
+		std::string source = "<html><head><style>";
+		for (int i = 0; i < 200; ++i)
+		{
+			source += ".c" + std::to_string(i) + " { margin: " + std::to_string(i % 13) + "px; color: #" + std::to_string(100 + i) + "; }\n";
+		}
+		source += "</style></head><body>\n" + pageSource + "<footer>" + boilerplate + "</footer></body></html>\n";
+		StringTemplate tpl(source);
+		GreenZone::Context context(pageContext(rows));
+
+		auto run = [&](char const * name, std::function< size_t() > respond)
+		{
+			size_t bytes = 0;
+			auto start = Clock::now();
+			for (int i = 0; i < renders; ++i)
+			{
+				bytes = respond();
+			}
+			std::cout << name << ": " << seconds(Clock::now() - start) / renders * 1e6 << " us/response, "
+				<< bytes << " bytes" << std::endl;
+		};
+
+		std::string page, compressed;
+		run("render then compress", [&]() -> size_t
+		{
+			tpl.render(&context, page);
+			compressed.clear();
+			GreenZone::StringWriter writer(compressed);
+			GreenZone::GzipWriter gzip(&writer, GreenZone::GzipWriter::Gzip, level, size_t(-1));
+			gzip.write(page);
+			gzip.finish();
+			return compressed.size();
+		});
+		for (size_t minPrecompressed : { size_t(-1), size_t(1024) })
+		{
+			run(minPrecompressed == size_t(-1) ? "streaming" : "streaming, precompressed", [&]() -> size_t
+			{
+				compressed.clear();
+				GreenZone::StringWriter writer(compressed);
+				GreenZone::GzipWriter gzip(&writer, GreenZone::GzipWriter::Gzip, level, minPrecompressed);
+				tpl.renderToStream(&gzip, &context);
+				gzip.finish();
+				return compressed.size();
+			});
+		}
+		std::cout << "uncompressed: " << page.size() << " bytes" << std::endl;
+		return 0;
+	}
+#endif
+}
+
+
+int main(int argc, char ** argv)
+{
+	std::map< std::string, std::function< int(std::vector< std::string > const &) > > const benchmarks
+	{
+		{ "concurrent-render", concurrentRender },
+		{ "batch-render", batchRender },
+		{ "parallel-loop", parallelLoop },
+		{ "rope-render", ropeRender },
+		{ "file-write", fileWrite },
+		{ "pooled-render", pooledRender },
+		{ "escape", escape },
+		{ "numbers", numbers },
+		{ "parse-render-free", parseRenderFree },
+		{ "objects", objects },
+		{ "parse", parse },
+		{ "lazy", lazy },
+		{ "projection", projection },
+#ifdef GREENZONE_WITH_ZLIB
+		{ "gzip", gzip },
+#endif
+	};
+
+	auto found = argc > 1 ? benchmarks.find(argv[1]) : benchmarks.end();
+	if (found == benchmarks.end())
+	{
+		std::cerr << "Usage: " << argv[0] << " <benchmark> [options]" << std::endl << "Benchmarks:" << std::endl;
+		for (auto const & benchmark : benchmarks)
+		{
+			std::cerr << "  " << benchmark.first << std::endl;
+		}
+		return 1;
+	}
+	try
+	{
+		return found->second(std::vector< std::string >(argv + 2, argv + argc));
+	}
+	catch (std::exception const & ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+}
@@ -39,5 +39,12 @@ int main( int argc, char ** argv )
 
     std::cout << tpl.render( cont ) << std::endl;
 
+    GreenZone::Parser optionsParser;
+    optionsParser.setDefaultEscapeMode( GreenZone::EscapeMode::Html );
+    optionsParser.setMinifyHtml( true );
+    GreenZone::FileTemplate optionsTpl( "options_test.tpl", optionsParser );
+
+    std::cout << optionsTpl.render( cont ) << std::endl;
+
     return 0;
 }
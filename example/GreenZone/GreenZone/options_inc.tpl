@@ -0,0 +1,2 @@
+{# Included templates inherit the default escape mode #}
+{{ "<i>" }} should be &lt;i&gt;
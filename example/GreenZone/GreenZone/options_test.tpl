@@ -0,0 +1,8 @@
+{# Rendered with Html as the parser's default escape mode and HTML minification #}
+{{ "<b>&</b>" }} should be &lt;b&gt;&amp;&lt;/b&gt;
+{{ "<b>"|safe }} should be <b>
+{% autoescape none %}{{ "<b>" }} should be <b>{% endautoescape %}
+{% include "options_inc.tpl" %}
+[a     b] should be [a b]
+<span title="a   b"></span> should be {{ "<span title=\"a   b\"></span>"|safe }}
+<pre>a   b</pre> should be {{ "<pre>a   b</pre>"|safe }}
@@ -12,6 +12,10 @@ Before extends
     {% endif %}
 {% endfor %}
 
+{# Testing condition without else branch #}
+[{% if false %}hidden{% endif %}] should be []
+[{% if 2 > 1 %}shown{% endif %}] should be [shown]
+
 {# Testing expression parser #}
 {{ "f" * 8 + "u" * 8 + "~" }} should be ffffffffuuuuuuuu~
 {{upper("f"*8+"u"*8+"~")}} should be FFFFFFFFUUUUUUUU~
@@ -33,6 +37,26 @@ Before extends
 {{ contains( "ada", "abracadabra" ) }} should be true
 {{ to_json( { "key1": "value1", "key2": [ 2, 4, 6] } ) }} should be { "key1": "value1", "key2": [ 2, 4, 6] }
 
+{# Testing escaping #}
+{{ "<b>&</b>" }} should be <b>&</b>
+{% autoescape html %}{{ "<b>\"&\"</b>" }} should be &lt;b&gt;&quot;&amp;&quot;&lt;/b&gt;{% endautoescape %}
+{% autoescape html %}{{ "<b>"|safe }} should be <b>{% endautoescape %}
+{% autoescape attribute %}{{ "a=`b`" }} should be a&#61;&#96;b&#96;{% endautoescape %}
+{% autoescape url %}{{ "a b/c" }} should be a%20b%2Fc{% endautoescape %}
+{% autoescape html %}{% autoescape none %}{{ "<i>" }} should be <i>{% endautoescape %}{% endautoescape %}
+
+{# Testing whitespace control #}
+[   {{- "a" -}}   ] should be [a]
+[  {%- if true -%}  b  {%- endif -%}  ] should be [b]
+[ {{ 2 -}}   ] should be [ 2]
+[{{-5}}] should be [-5]
+
+{# Testing flush points, which writers that do not stream ignore #}
+[a{% flush %}b] should be [ab]
+
+{# Testing defer blocks, rendered in place by writers that do not defer #}
+[a{% defer deferTest %}{{ 1 + 1 }}{% enddefer %}b] should be [a2b]
+
 {# Testing include tag #}
 {% if true %}
     {% include [ "inc_test.tpl" ] %}
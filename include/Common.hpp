@@ -8,30 +8,139 @@
 
 #include <string>
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 
+#if defined(__has_include)
+#if __has_include(<charconv>) && ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define GREENZONE_HAS_TO_CHARS
+#endif
+#endif
+#endif
+
 
+#ifndef GREENZONE_HAS_TO_CHARS
+#include <Grisu.hpp>
+#endif
+
+#include <sys/stat.h>
 #ifdef _MSC_VER
 #define snprintf _snprintf
 #include <io.h>
+#else
+#include <unistd.h>
 #endif
 
 namespace GreenZone
 {
-	// Taken from here http://stackoverflow.com/a/15167203/2080453
-	inline std::string dbl2str(double d)
+	enum { NumberBufferSize = 32 };
+
+	// Writes the decimal digits of `value` into `buffer` like formatNumber() does.
+	inline size_t formatInteger(long long value, char * buffer)
+	{
+		static char const digitPairs[] =
+			"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+			"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		char digits[NumberBufferSize];
+		char * end = digits + sizeof(digits), * first = end;
+		unsigned long long magnitude = value < 0 ? 0ull - static_cast< unsigned long long >(value) : value;
+		while (magnitude >= 100)
+		{
+			unsigned pair = static_cast< unsigned >(magnitude % 100) * 2;
+			magnitude /= 100;
+			*--first = digitPairs[pair + 1];
+			*--first = digitPairs[pair];
+		}
+		if (magnitude >= 10)
+		{
+			unsigned pair = static_cast< unsigned >(magnitude) * 2;
+			*--first = digitPairs[pair + 1];
+			*--first = digitPairs[pair];
+		}
+		else
+		{
+			*--first = static_cast< char >('0' + magnitude);
+		}
+		if (value < 0)
+		{
+			*--first = '-';
+		}
+		std::memcpy(buffer, first, end - first);
+		return end - first;
+	}
+
+	// Writes `value` into `buffer` (at least NumberBufferSize bytes) without terminating
+	// it and returns the length. Integers up to 2^53 are written as such, other values
+	// in the shortest form that reads back as the same double.
+	inline size_t formatNumber(double value, char * buffer)
 	{
-		size_t len = snprintf(0, 0, "%.10f", d);
-		std::string s(len + 1, 0);
-		snprintf(&s[0], len + 1, "%.10f", d);
-		s.pop_back();
-		s.erase(s.find_last_not_of('0') + 1, std::string::npos);
-		if (s.back() == '.')
+		if (value > -9007199254740992.0 && value < 9007199254740992.0 && value == static_cast< double >(static_cast< long long >(value))
+			&& (value != 0 || !std::signbit(value)))
 		{
-			s.pop_back();
+			return formatInteger(static_cast< long long >(value), buffer);
 		}
+#ifdef GREENZONE_HAS_TO_CHARS
+		return std::to_chars(buffer, buffer + NumberBufferSize, value).ptr - buffer;
+#else
+		return Grisu::format(value, buffer);
+#endif
+	}
 
-		return s;
+	// Integer arithmetic reporting overflow: returns false, leaving `result` unspecified,
+	// if the exact result does not fit.
+	inline bool checkedAdd(long long lhs, long long rhs, long long & result)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return !__builtin_add_overflow(lhs, rhs, &result);
+#else
+		if ((rhs > 0 && lhs > LLONG_MAX - rhs) || (rhs < 0 && lhs < LLONG_MIN - rhs))
+		{
+			return false;
+		}
+		result = lhs + rhs;
+		return true;
+#endif
+	}
+
+	inline bool checkedSubtract(long long lhs, long long rhs, long long & result)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return !__builtin_sub_overflow(lhs, rhs, &result);
+#else
+		if ((rhs < 0 && lhs > LLONG_MAX + rhs) || (rhs > 0 && lhs < LLONG_MIN + rhs))
+		{
+			return false;
+		}
+		result = lhs - rhs;
+		return true;
+#endif
+	}
+
+	inline bool checkedMultiply(long long lhs, long long rhs, long long & result)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return !__builtin_mul_overflow(lhs, rhs, &result);
+#else
+		if ((lhs == -1 && rhs == LLONG_MIN) || (rhs == -1 && lhs == LLONG_MIN))
+		{
+			return false;
+		}
+		result = static_cast< long long >(static_cast< unsigned long long >(lhs) * static_cast< unsigned long long >(rhs));
+		return !rhs || result / rhs == lhs;
+#endif
+	}
+
+	inline std::string dbl2str(double d)
+	{
+		char buffer[NumberBufferSize];
+		return std::string(buffer, formatNumber(d, buffer));
 	}
 
 	inline std::string replaceString(std::string subject, const std::string & search, const std::string & replace)
@@ -59,6 +168,34 @@ namespace GreenZone
 		return access(filePath.c_str(), 4) != -1;
 	}
 
+	// Modification time and size of a file, to tell whether it changed. Zeroes if the file
+	// can not be read.
+	struct FileStamp
+	{
+		long long modified;
+		long long size;
+
+		bool operator==(FileStamp const & other) const { return modified == other.modified && size == other.size; }
+		bool operator!=(FileStamp const & other) const { return !(*this == other); }
+	};
+
+	inline FileStamp fileStamp(std::string const & filePath)
+	{
+#ifdef _MSC_VER
+		struct _stat64 info;
+		if (_stat64(filePath.c_str(), &info) != 0)
+#else
+		struct stat info;
+		if (stat(filePath.c_str(), &info) != 0)
+#endif
+		{
+			FileStamp none = { 0, 0 };
+			return none;
+		}
+		FileStamp stamp = { static_cast< long long >(info.st_mtime), static_cast< long long >(info.st_size) };
+		return stamp;
+	}
+
 	typedef std::string(*StrConcat)(std::string const &, std::string const &);
 	static StrConcat strConcat = std::operator+;
 
@@ -6,13 +6,22 @@
  */
 #pragma once
 
+#include <Context/FastParser.hpp>
+#include <Context/LazyDocument.hpp>
+#include <Context/Projection.hpp>
 #include <Context/json11.hpp>
 #include <Common.hpp>
 #include <Exception.hpp>
 
+#include <condition_variable>
+#include <exception>
 #include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <cmath>
 #include <iostream>
@@ -26,6 +35,13 @@
 										        }
 namespace GreenZone
 {
+	// Writes a NUMBER value like formatNumber(), integers without going through a double.
+	inline size_t formatNumber(json11::Json const & number, char * buffer)
+	{
+		return number.is_integer() ? formatInteger(number.integer_value(), buffer)
+			: formatNumber(number.number_value(), buffer);
+	}
+
 	class Context
 	{
 	public:
@@ -35,19 +51,50 @@ namespace GreenZone
 		typedef std::function< json11::Json(std::vector< json11::Json > const &) > Function;
 		typedef std::map< std::string, Function > Functions;
 
+		typedef std::function< json11::Json() > DataProvider;
+		// Receives the value of an asynchronous provider, or the exception it failed with
+		// (the value being then ignored).
+		typedef std::function< void(json11::Json const &, std::exception_ptr) > ProviderCallback;
+		typedef std::function< void(ProviderCallback) > AsyncDataProvider;
+
+		// A dotted name split into interned keys, for names resolved over and over.
+		typedef std::vector< json11::Key > Path;
+
+		enum Parsing
+		{
+			Eager,
+			// Keeps the JSON text and only decodes the values resolved, see
+			// json11::LazyDocument: suited to large data a template reads little of. Errors
+			// in the text are only found where it is read, and thrown by resolve().
+			Lazy
+		};
+
 		Context(std::string const & json)
 			: Context()
 		{
-			std::string err;
-			m_json = json11::Json::parse(json, err);
-			if (err.size())
-			{
-				throw JsonError(err);
-			}
-			if (!m_json.is_object())
+			parse(json);
+		}
+
+		Context(std::string json, Parsing parsing)
+			: Context()
+		{
+			size_t start = json.find_first_not_of(" \t\r\n");
+			if (parsing == Lazy && start != std::string::npos && json[start] == '{')
 			{
-				throw JsonError("Context data must be presented in dictionary type.");
+				m_json = json11::Json::object();
+				m_document = std::make_shared< json11::LazyDocument >(std::move(json));
+				return;
 			}
+			parse(json);
+		}
+
+		// Keeps only the values reached by `projection` (see Template::projection()), the
+		// rest of the text is stepped over without being decoded.
+		Context(std::string const & json, json11::Projection const & projection)
+			: Context()
+		{
+			std::string err;
+			setParsed(projection.parse(json, err), err);
 		}
 
 		Context(json11::Json const & json)
@@ -60,10 +107,16 @@ namespace GreenZone
 			}
 		}
 
-		json11::Json json() const
+		// The context data; for a lazy context only the values set on it (e.g. by loops),
+		// those of the document are reached by resolve() and member().
+		json11::Json const & json() const
 		{
 			return m_json;
 		}
+		std::shared_ptr< json11::LazyDocument > const & document() const
+		{
+			return m_document;
+		}
 		void setJson(json11::Json const & json)
 		{
 			if (!m_json.is_object())
@@ -75,20 +128,225 @@ namespace GreenZone
 
 		json11::Json resolve(std::string const & name) const
 		{
-			json11::Json result = m_json;
-			static const std::regex splitter(R"(\.)");
-			std::sregex_token_iterator iter(name.begin(), name.end(), splitter, -1);
-			static const std::sregex_token_iterator end;
-			for (; iter != end; ++iter)
+			json11::Json value;
+			if (!find(name, value))
+			{
+				throw TemplateContextError(name);
+			}
+			return value;
+		}
+
+		json11::Json resolve(Path const & path) const
+		{
+			json11::Json value;
+			if (!find(path, value))
+			{
+				throw TemplateContextError(joinPath(path));
+			}
+			return value;
+		}
+
+		// Like resolve(), returning false instead of throwing if there is no such value (or
+		// it is null), e.g. for templates testing optional values.
+		bool find(std::string const & name, json11::Json & value) const
+		{
+			// walks references, the value is copied once at the end
+			json11::Json fetched;
+			json11::Json const * result = &m_json;
+			size_t start = 0, dot;
+			do
+			{
+				dot = name.find('.', start);
+				json11::Json const * next = &(*result)[name.substr(start, dot - start)];
+				if (next->is_null() && !start && m_document)
+				{
+					return find(compilePath(name), value);
+				}
+				if (next->is_null() && !start && m_providers)
+				{
+					fetched = provided(name.substr(0, dot));
+					next = &fetched;
+				}
+				if (next->is_null())
+				{
+					return false;
+				}
+				result = next;
+				start = dot + 1;
+			} while (dot != std::string::npos);
+			value = *result;
+			return true;
+		}
+
+		bool find(Path const & path, json11::Json & value) const
+		{
+			json11::Json fetched;
+			json11::Json const * result = &m_json;
+			for (size_t i = 0; i < path.size(); ++i)
+			{
+				json11::Json const * next = &(*result)[path[i]];
+				if (next->is_null() && !i && m_document)
+				{
+					// the rest of the path is walked in the text
+					if (findInDocument(path, path.size(), &fetched))
+					{
+						value = fetched;
+						return true;
+					}
+					if (findInDocument(path, 1, nullptr))
+					{
+						return false;
+					}
+				}
+				if (next->is_null() && !i && m_providers)
+				{
+					fetched = provided(path[i].name);
+					next = &fetched;
+				}
+				if (next->is_null())
+				{
+					return false;
+				}
+				result = next;
+			}
+			value = *result;
+			return true;
+		}
+
+		// Top level value of the context data, null if there is none.
+		json11::Json member(std::string const & name) const
+		{
+			json11::Json value = m_json[name];
+			if (value.is_null() && m_document)
 			{
-				json11::Json tmp = result[*iter];
-				if (tmp.is_null())
+				Path path(1, json11::Key(name));
+				findInDocument(path, 1, &value);
+			}
+			return value;
+		}
+
+		static Path compilePath(std::string const & name)
+		{
+			Path path;
+			size_t start = 0, dot;
+			do
+			{
+				dot = name.find('.', start);
+				path.push_back(json11::Key(name.substr(start, dot - start)));
+				start = dot + 1;
+			} while (dot != std::string::npos);
+			return path;
+		}
+
+		// Top level value fetched on demand, e.g. from a slow service. Values of the
+		// context data take precedence. The provider runs once for this context and the
+		// loop contexts derived from it: on its own thread once prefetch()ed (Template
+		// does that for the names a template reads before rendering it), otherwise on the
+		// first thread resolving the name. Its exceptions are thrown by resolve(), which
+		// blocks until the value has arrived; AsyncRenderer does not.
+		// Providers must be registered before rendering starts.
+		void provide(std::string const & name, DataProvider provider)
+		{
+#ifdef JSON11_NONATOMIC_REFCOUNT
+			throw Exception("Data providers need atomic reference counts, the build defines JSON11_NONATOMIC_REFCOUNT");
+#endif
+			if (!m_providers)
+			{
+				m_providers = std::make_shared< Providers >();
+			}
+			(*m_providers)[name] = std::make_shared< PendingValue >(provider);
+		}
+		// Like provide(), for a provider that does not block: it starts fetching and
+		// returns, then passes the value to the callback, from any thread. AsyncRenderer
+		// renders what does not depend on it in the meantime.
+		void provideAsync(std::string const & name, AsyncDataProvider provider)
+		{
+#ifdef JSON11_NONATOMIC_REFCOUNT
+			throw Exception("Data providers need atomic reference counts, the build defines JSON11_NONATOMIC_REFCOUNT");
+#endif
+			if (!m_providers)
+			{
+				m_providers = std::make_shared< Providers >();
+			}
+			(*m_providers)[name] = std::make_shared< PendingValue >(provider);
+		}
+		bool hasProviders() const
+		{
+			return m_providers && m_providers->size();
+		}
+
+		// Starts the providers of the given top level names concurrently.
+		void prefetch(std::vector< std::string > const & names) const
+		{
+			if (!m_providers)
+			{
+				return;
+			}
+			for (auto const & name : names)
+			{
+				auto found = m_providers->find(name);
+				if (found != m_providers->end())
 				{
-					throw TemplateContextError(name);
+					found->second->start(std::launch::async);
 				}
-				result = tmp;
 			}
-			return result;
+		}
+		void prefetchAll() const
+		{
+			if (!m_providers)
+			{
+				return;
+			}
+			for (auto const & provider : *m_providers)
+			{
+				provider.second->start(std::launch::async);
+			}
+		}
+
+		// Whether the top level value `name` can be resolved without waiting for a provider.
+		// If not, its provider is started and `continuation` is called once the value has
+		// arrived, on the thread delivering it.
+		bool whenProvided(std::string const & name, std::function< void() > continuation) const
+		{
+			if (!m_providers || !member(name).is_null())
+			{
+				return true;
+			}
+			auto found = m_providers->find(name);
+			if (found == m_providers->end())
+			{
+				return true;
+			}
+			found->second->start(std::launch::async);
+			return found->second->whenReady(continuation);
+		}
+		std::vector< std::string > providerNames() const
+		{
+			std::vector< std::string > names;
+			if (m_providers)
+			{
+				for (auto const & provider : *m_providers)
+				{
+					names.push_back(provider.first);
+				}
+			}
+			return names;
+		}
+
+		// Value of a provider, waiting for it if it is still being fetched. Null if
+		// there is no such provider.
+		json11::Json provided(std::string const & name) const
+		{
+			if (!m_providers)
+			{
+				return json11::Json();
+			}
+			auto found = m_providers->find(name);
+			if (found == m_providers->end())
+			{
+				return json11::Json();
+			}
+			return found->second->get();
 		}
 
 		BinaryOperators const & binaryOperators() const
@@ -119,6 +377,11 @@ namespace GreenZone
 						{
 							// Yes-yes, I know about implicit constructors feature
 							// but I'd rather to call explicit instead
+							long long result;
+							if (lhs.is_integer() && rhs.is_integer() && checkedAdd(lhs.integer_value(), rhs.integer_value(), result))
+							{
+								return json11::Json(result);
+							}
 							return json11::Json(lhs.number_value() + rhs.number_value());
 						}
 					},
@@ -134,7 +397,7 @@ namespace GreenZone
 						std::make_tuple(json11::Json::NUMBER, json11::Json::STRING),
 						[](json11::Json const & lhs, json11::Json const & rhs) -> json11::Json
 						{
-							return json11::Json(dbl2str(lhs.number_value()) + rhs.string_value());
+							return json11::Json(numberString(lhs) + rhs.string_value());
 						}
 					},
 
@@ -142,7 +405,7 @@ namespace GreenZone
 						std::make_tuple(json11::Json::STRING, json11::Json::NUMBER),
 						[](json11::Json const & lhs, json11::Json const & rhs) -> json11::Json
 						{
-							return json11::Json(lhs.string_value() + dbl2str(rhs.number_value()));
+							return json11::Json(lhs.string_value() + numberString(rhs));
 						}
 					}
 				};
@@ -164,6 +427,11 @@ namespace GreenZone
 						std::make_tuple(json11::Json::NUMBER, json11::Json::NUMBER),
 						[](json11::Json const & lhs, json11::Json const & rhs) -> json11::Json
 						{
+							long long result;
+							if (lhs.is_integer() && rhs.is_integer() && checkedSubtract(lhs.integer_value(), rhs.integer_value(), result))
+							{
+								return json11::Json(result);
+							}
 							return json11::Json(lhs.number_value() - rhs.number_value());
 						}
 					}
@@ -186,6 +454,11 @@ namespace GreenZone
 						std::make_tuple(json11::Json::NUMBER, json11::Json::NUMBER),
 						[](json11::Json const & lhs, json11::Json const & rhs) -> json11::Json
 						{
+							long long result;
+							if (lhs.is_integer() && rhs.is_integer() && checkedMultiply(lhs.integer_value(), rhs.integer_value(), result))
+							{
+								return json11::Json(result);
+							}
 							return json11::Json(lhs.number_value() * rhs.number_value());
 						}
 					},
@@ -225,6 +498,15 @@ namespace GreenZone
 						std::make_tuple(json11::Json::NUMBER, json11::Json::NUMBER),
 						[](json11::Json const & lhs, json11::Json const & rhs) -> json11::Json
 						{
+							// integers stay integers when the division is exact
+							if (lhs.is_integer() && rhs.is_integer())
+							{
+								long long dividend = lhs.integer_value(), divisor = rhs.integer_value();
+								if (divisor && !(dividend == LLONG_MIN && divisor == -1) && !(dividend % divisor))
+								{
+									return json11::Json(dividend / divisor);
+								}
+							}
 							return json11::Json(lhs.number_value() / rhs.number_value());
 						}
 					}
@@ -449,10 +731,182 @@ namespace GreenZone
 			})
 			{}
 
+	protected:
+		void parse(std::string const & json)
+		{
+			std::string err;
+			setParsed(json11::FastParser::parse(json, err), err);
+		}
+		void setParsed(json11::Json const & json, std::string const & err)
+		{
+			m_json = json;
+			if (err.size())
+			{
+				throw JsonError(err);
+			}
+			if (!m_json.is_object())
+			{
+				throw JsonError("Context data must be presented in dictionary type.");
+			}
+		}
+
+		// Whether the first `length` keys of `path` lead to a value in the lazy document.
+		bool findInDocument(Path const & path, size_t length, json11::Json * value) const
+		{
+			std::string err;
+			bool found = m_document->find(path.data(), path.data() + length, value, err);
+			if (err.size())
+			{
+				throw JsonError(err);
+			}
+			return found;
+		}
+
+		static std::string joinPath(Path const & path)
+		{
+			std::string name;
+			for (auto const & key : path)
+			{
+				name += (name.empty() ? "" : ".") + key.name;
+			}
+			return name;
+		}
+
+		static std::string numberString(json11::Json const & number)
+		{
+			char buffer[NumberBufferSize];
+			return std::string(buffer, formatNumber(number, buffer));
+		}
+
+		class PendingValue : public std::enable_shared_from_this< PendingValue >
+		{
+		public:
+			PendingValue(DataProvider provider)
+				: m_provider(provider), m_started(false), m_arrived(false)
+			{}
+			PendingValue(AsyncDataProvider provider)
+				: m_asyncProvider(provider), m_started(false), m_arrived(false)
+			{}
+			// A blocking provider runs on a thread of its own with std::launch::async,
+			// otherwise on the calling thread. That thread is detached and keeps the value
+			// alive, so the context may be destroyed by a continuation it runs.
+			void start(std::launch policy)
+			{
+				{
+					std::lock_guard< std::mutex > lock(m_mutex);
+					if (m_started)
+					{
+						return;
+					}
+					m_started = true;
+				}
+				if (m_asyncProvider)
+				{
+					// the callback may come after the context is gone
+					std::shared_ptr< PendingValue > self = shared_from_this();
+					try
+					{
+						m_asyncProvider([self](json11::Json const & value, std::exception_ptr error)
+						{
+							self->arrive(value, error);
+						});
+					}
+					catch (...)
+					{
+						arrive(json11::Json(), std::current_exception());
+					}
+				}
+				else if (policy == std::launch::async)
+				{
+					std::shared_ptr< PendingValue > self = shared_from_this();
+					std::thread([self]() { self->fetch(); }).detach();
+				}
+				else
+				{
+					fetch();
+				}
+			}
+
+			json11::Json get()
+			{
+				start(std::launch::deferred);
+				std::unique_lock< std::mutex > lock(m_mutex);
+				m_arrival.wait(lock, [this]() { return m_arrived; });
+				if (m_error)
+				{
+					std::rethrow_exception(m_error);
+				}
+				return m_value;
+			}
+
+			// False if the value has not arrived yet: `continuation` is then called once it has.
+			bool whenReady(std::function< void() > continuation)
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				if (m_arrived)
+				{
+					return true;
+				}
+				m_continuations.push_back(continuation);
+				return false;
+			}
+
+		private:
+			void fetch()
+			{
+				json11::Json value;
+				std::exception_ptr error;
+				try
+				{
+					value = m_provider();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				arrive(value, error);
+			}
+
+			// Only the first value of a provider calling back more than once is kept.
+			void arrive(json11::Json const & value, std::exception_ptr error)
+			{
+				std::vector< std::function< void() > > continuations;
+				{
+					std::lock_guard< std::mutex > lock(m_mutex);
+					if (m_arrived)
+					{
+						return;
+					}
+					m_value = value;
+					m_error = error;
+					m_arrived = true;
+					continuations.swap(m_continuations);
+				}
+				m_arrival.notify_all();
+				for (auto const & continuation : continuations)
+				{
+					continuation();
+				}
+			}
+
+			DataProvider m_provider;
+			AsyncDataProvider m_asyncProvider;
+			bool m_started;
+			bool m_arrived;
+			json11::Json m_value;
+			std::exception_ptr m_error;
+			std::vector< std::function< void() > > m_continuations;
+			std::mutex m_mutex;
+			std::condition_variable m_arrival;
+		};
+		typedef std::map< std::string, std::shared_ptr< PendingValue > > Providers;
+
 	protected:
 		json11::Json m_json;
+		std::shared_ptr< json11::LazyDocument > m_document;
 		BinaryOperators m_binaryOperations;
 		Functions m_functions;
+		std::shared_ptr< Providers > m_providers;
 	};
 
 } /* namespace RedZone */
@@ -0,0 +1,524 @@
+/*
+ * FastParser.hpp
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <Context/json11.hpp>
+#include <Context/StructuralIndex.hpp>
+
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace json11
+{
+
+	/* FastParser
+	 *
+	 * Parses JSON into the same Json values as Json::parse, in two passes: a StructuralIndex of
+	 * the input, then a walk of its positions that decodes the values. Strings without escapes
+	 * are copied in one piece, found 16 bytes at a time, and numbers are decoded without strtod
+	 * when that is exact. Invalid input is handed to Json::parse, so errors are reported with
+	 * the same messages.
+	 */
+	class FastParser final
+	{
+	public:
+		static Json parse(const std::string & in, std::string & err)
+		{
+			StructuralIndex index;
+			if (index.build(in.data(), in.size()))
+			{
+				FastParser parser(in, index);
+				Json result;
+				if (parser.parse_value(result, 0) && parser.at_end())
+					return result;
+			}
+			return Json::parse(in, err);
+		}
+
+		// Walks an index of `in` built beforehand, from its position `next` on.
+		FastParser(const std::string & in, const StructuralIndex & index, size_t next = 0)
+			: m_in(in), m_index(index), m_next(next)
+		{}
+
+		// Decodes the value at the next position, found `depth` levels down the document.
+		// False if it is not valid JSON.
+		bool parse_value(Json & out, int depth)
+		{
+			if (depth > max_depth)
+				return false;
+
+			size_t position;
+			switch (next(position))
+			{
+			case '{':
+			{
+				if (peek() == '}')
+				{
+					++m_next;
+					out = Json::object();
+					return true;
+				}
+				// members and items are gathered on stacks shared by all levels, so each
+				// object or array gets one allocation of the right size
+				size_t first = m_members.size();
+				while (true)
+				{
+					std::string key;
+					Json value;
+					if (!parse_key(key) || !parse_value(value, depth + 1))
+						return false;
+					m_members.push_back(Json::object::value_type(std::move(key), std::move(value)));
+					char ch = next(position);
+					if (ch == '}')
+						break;
+					if (ch != ',')
+						return false;
+				}
+				out = Json::object(take(m_members, first), true);
+				return true;
+			}
+			case '[':
+			{
+				if (peek() == ']')
+				{
+					++m_next;
+					out = Json::array();
+					return true;
+				}
+				size_t first = m_items.size();
+				while (true)
+				{
+					Json item;
+					if (!parse_value(item, depth + 1))
+						return false;
+					m_items.push_back(std::move(item));
+					char ch = next(position);
+					if (ch == ']')
+						break;
+					if (ch != ',')
+						return false;
+				}
+				out = take(m_items, first);
+				return true;
+			}
+			case '"':
+			{
+				std::string value;
+				if (!parse_string(position, value))
+					return false;
+				out = std::move(value);
+				return true;
+			}
+			case 't':
+				out = true;
+				return parse_literal(position, "true", 4);
+			case 'f':
+				out = false;
+				return parse_literal(position, "false", 5);
+			case 'n':
+				out = Json();
+				return parse_literal(position, "null", 4);
+			default:
+				return parse_number(position, out);
+			}
+		}
+
+		// Decodes the string opening at `position` like Json::parse does, unpaired surrogates
+		// included. False on an invalid escape.
+		bool parse_string(size_t position, std::string & out) const
+		{
+			const char * p = m_in.data() + position + 1;
+			const char * end = m_in.data() + m_in.size();
+			long last_escaped_codepoint = -1;
+			while (true)
+			{
+				const char * run = p;
+				p = find_quote_or_backslash(p);
+				if (p != run)
+				{
+					encode_utf8(last_escaped_codepoint, out);
+					last_escaped_codepoint = -1;
+					out.append(run, p);
+				}
+				if (*p == '"')
+				{
+					encode_utf8(last_escaped_codepoint, out);
+					return true;
+				}
+
+				char ch = *++p;
+				++p;
+				if (ch == 'u')
+				{
+					if (end - p < 4)
+						return false;
+					long codepoint = 0;
+					for (int j = 0; j < 4; ++j, ++p)
+					{
+						char digit = *p;
+						if (is_digit(digit))
+							codepoint = codepoint * 16 + (digit - '0');
+						else if (digit >= 'a' && digit <= 'f')
+							codepoint = codepoint * 16 + (digit - 'a' + 10);
+						else if (digit >= 'A' && digit <= 'F')
+							codepoint = codepoint * 16 + (digit - 'A' + 10);
+						else
+							return false;
+					}
+					if (last_escaped_codepoint >= 0xD800 && last_escaped_codepoint <= 0xDBFF
+						&& codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+					{
+						encode_utf8((((last_escaped_codepoint - 0xD800) << 10) | (codepoint - 0xDC00)) + 0x10000, out);
+						last_escaped_codepoint = -1;
+					}
+					else
+					{
+						encode_utf8(last_escaped_codepoint, out);
+						last_escaped_codepoint = codepoint;
+					}
+					continue;
+				}
+
+				encode_utf8(last_escaped_codepoint, out);
+				last_escaped_codepoint = -1;
+				switch (ch)
+				{
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case '"': case '\\': case '/': out += ch; break;
+				default:
+					return false;
+				}
+			}
+		}
+
+		// Decodes the member key at the next position and steps over the colon after it.
+		bool parse_key(std::string & key)
+		{
+			size_t position;
+			return next(position) == '"' && parse_string(position, key) && next(position) == ':';
+		}
+
+		// Steps over the value at the next position without decoding it: only the brackets
+		// of containers are counted.
+		bool skip_value()
+		{
+			size_t position;
+			char ch = next(position);
+			if (ch != '{' && ch != '[')
+				return ch && ch != '}' && ch != ']' && ch != ':' && ch != ',';
+			for (int depth = 1; depth;)
+			{
+				ch = next(position);
+				if (ch == '{' || ch == '[')
+					++depth;
+				else if (ch == '}' || ch == ']')
+					--depth;
+				else if (!ch)
+					return false;
+			}
+			return true;
+		}
+
+		// Steps over the value at the next position, checking it like parse_value() does
+		// but allocating nothing.
+		bool check_value(int depth)
+		{
+			if (depth > max_depth)
+				return false;
+
+			size_t position;
+			switch (next(position))
+			{
+			case '{':
+				if (skip_if('}'))
+					return true;
+				do
+				{
+					if (next(position) != '"' || !check_string(position) || next(position) != ':'
+						|| !check_value(depth + 1))
+					{
+						return false;
+					}
+				} while (skip_if(','));
+				return skip_if('}');
+			case '[':
+				if (skip_if(']'))
+					return true;
+				do
+				{
+					if (!check_value(depth + 1))
+						return false;
+				} while (skip_if(','));
+				return skip_if(']');
+			case '"':
+				return check_string(position);
+			case 't':
+				return parse_literal(position, "true", 4);
+			case 'f':
+				return parse_literal(position, "false", 5);
+			case 'n':
+				return parse_literal(position, "null", 4);
+			default:
+			{
+				Json number;
+				return parse_number(position, number);
+			}
+			}
+		}
+
+		// The character at the next position, '\0' at the end of the input.
+		char peek() const
+		{
+			return m_in[m_index[m_next]];
+		}
+		// Steps over the next position if it holds `ch`.
+		bool skip_if(char ch)
+		{
+			if (peek() != ch)
+				return false;
+			++m_next;
+			return true;
+		}
+		bool at_end() const
+		{
+			return m_next + 1 == m_index.size();
+		}
+		size_t position() const
+		{
+			return m_next;
+		}
+
+	private:
+		char next(size_t & position)
+		{
+			position = m_index[m_next++];
+			return m_in[position];
+		}
+
+		static bool is_digit(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+
+		// Values end at whitespace, at an operator or at the end of the input.
+		bool ends_value(size_t position) const
+		{
+			switch (m_in[position])
+			{
+			case ' ': case '\t': case '\n': case '\r':
+			case '{': case '}': case '[': case ']': case ':': case ',':
+				return true;
+			default:
+				return position == m_in.size();
+			}
+		}
+
+		template <class T>
+		static std::vector<T> take(std::vector<T> & stack, size_t first)
+		{
+			std::vector<T> taken(std::make_move_iterator(stack.begin() + first), std::make_move_iterator(stack.end()));
+			stack.erase(stack.begin() + first, stack.end());
+			return taken;
+		}
+
+		bool parse_literal(size_t position, const char * literal, size_t length) const
+		{
+			return m_in.compare(position, length, literal) == 0 && ends_value(position + length);
+		}
+
+		static void encode_utf8(long pt, std::string & out)
+		{
+			if (pt < 0)
+				return;
+
+			if (pt < 0x80)
+			{
+				out += char(pt);
+			}
+			else if (pt < 0x800)
+			{
+				out += char((pt >> 6) | 0xC0);
+				out += char((pt & 0x3F) | 0x80);
+			}
+			else if (pt < 0x10000)
+			{
+				out += char((pt >> 12) | 0xE0);
+				out += char(((pt >> 6) & 0x3F) | 0x80);
+				out += char((pt & 0x3F) | 0x80);
+			}
+			else
+			{
+				out += char((pt >> 18) | 0xF0);
+				out += char(((pt >> 12) & 0x3F) | 0x80);
+				out += char(((pt >> 6) & 0x3F) | 0x80);
+				out += char((pt & 0x3F) | 0x80);
+			}
+		}
+
+		// The first quote or backslash from `p` on. The index has checked that the string
+		// is terminated.
+		const char * find_quote_or_backslash(const char * p) const
+		{
+#ifdef JSON11_SSE2
+			const char * end = m_in.data() + m_in.size();
+			const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+			for (; end - p >= 16; p += 16)
+			{
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+				int found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)));
+				if (found)
+					return p + trailing_zeros(uint64_t(found));
+			}
+#endif
+			while (*p != '"' && *p != '\\')
+				++p;
+			return p;
+		}
+
+		bool check_string(size_t position) const
+		{
+			const char * p = m_in.data() + position + 1;
+			const char * end = m_in.data() + m_in.size();
+			while (*(p = find_quote_or_backslash(p)) != '"')
+			{
+				char ch = p[1];
+				p += 2;
+				if (ch == 'u')
+				{
+					if (end - p < 4)
+						return false;
+					for (const char * digits = p; p != digits + 4; ++p)
+					{
+						if (!is_digit(*p) && !(*p >= 'a' && *p <= 'f') && !(*p >= 'A' && *p <= 'F'))
+							return false;
+					}
+				}
+				else if (ch != 'b' && ch != 'f' && ch != 'n' && ch != 'r' && ch != 't'
+					&& ch != '"' && ch != '\\' && ch != '/')
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Integers in the long long range are accumulated exactly, like strtoll. Other numbers
+		// with at most 19 significant digits, a mantissa below 2^53 and a power of ten up to
+		// 22 are one exact multiplication or division away from the correctly rounded double;
+		// the rest goes through strtod, like the atof of Json::parse.
+		bool parse_number(size_t position, Json & out) const
+		{
+			const char * start = m_in.data() + position;
+			const char * p = start;
+			bool negative = *p == '-';
+			if (negative)
+				++p;
+
+			uint64_t mantissa = 0;
+			int digits = 0, exponent = 0;
+			auto accumulate = [&](char digit)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (digit - '0');
+					if (mantissa)
+						++digits;
+				}
+				else
+				{
+					digits = 20;
+				}
+			};
+
+			if (*p == '0')
+			{
+				++p;
+				if (is_digit(*p))
+					return false;
+			}
+			else if (is_digit(*p))
+			{
+				while (is_digit(*p))
+					accumulate(*p++);
+			}
+			else
+			{
+				return false;
+			}
+
+			// 19 digits never overflow the mantissa, the sign allows one more below zero
+			uint64_t const max_integer = uint64_t(std::numeric_limits<long long>::max()) + (negative ? 1 : 0);
+			if (*p != '.' && *p != 'e' && *p != 'E' && digits <= 19 && mantissa <= max_integer)
+			{
+				out = Json(negative ? -(long long)(mantissa - 1) - 1 : (long long)mantissa);
+				return ends_value(p - m_in.data());
+			}
+
+			if (*p == '.')
+			{
+				++p;
+				if (!is_digit(*p))
+					return false;
+				for (; is_digit(*p); --exponent)
+					accumulate(*p++);
+			}
+
+			if (*p == 'e' || *p == 'E')
+			{
+				++p;
+				bool negative_exponent = *p == '-';
+				if (*p == '+' || *p == '-')
+					++p;
+				if (!is_digit(*p))
+					return false;
+				int value = 0;
+				for (; is_digit(*p); ++p)
+				{
+					if (value < 100000)
+						value = value * 10 + (*p - '0');
+				}
+				exponent += negative_exponent ? -value : value;
+			}
+
+			if (!ends_value(p - m_in.data()))
+				return false;
+
+#if (defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0) || defined(_M_X64)
+			static const double powers_of_ten[] =
+			{
+				1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+			};
+			if (digits <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+			{
+				double value = double(mantissa);
+				value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+				out = Json(negative ? -value : value);
+				return true;
+			}
+#endif
+			out = Json(std::strtod(start, nullptr));
+			return true;
+		}
+
+		const std::string & m_in;
+		const StructuralIndex & m_index;
+		size_t m_next;  // in m_index
+		std::vector<Json::object::value_type> m_members;
+		std::vector<Json> m_items;
+	};
+
+} // namespace json11
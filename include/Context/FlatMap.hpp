@@ -0,0 +1,386 @@
+/*
+ * FlatMap.hpp
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <Context/Symbols.hpp>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace json11
+{
+
+	/* FlatMap
+	 *
+	 * The Json::object container: members are kept in one vector, sorted by key like in a
+	 * std::map, or in insertion order if JSON11_INSERTION_ORDER is defined. Key hashes and
+	 * symbols (of the keys interned when the member was added) are computed once and objects
+	 * of more than LinearLimit members also keep an open addressing table of them, so lookups
+	 * compare a string only on a hash match, or nothing but symbols for a Key whose key had
+	 * been interned. Copying an object copies four vectors. Unlike std::map, any modification
+	 * invalidates iterators and references, and keys must not be changed through iterators.
+	 */
+	template <class Value>
+	class FlatMap
+	{
+	public:
+		typedef std::string key_type;
+		typedef Value mapped_type;
+		typedef std::pair<std::string, Value> value_type;
+		typedef typename std::vector<value_type>::iterator iterator;
+		typedef typename std::vector<value_type>::const_iterator const_iterator;
+		typedef size_t size_type;
+
+		enum { LinearLimit = 8 };
+
+		FlatMap() {}
+		// Duplicate keys: the first member is kept, like std::map does.
+		template <class InputIterator>
+		FlatMap(InputIterator first, InputIterator last)
+		{
+			for (; first != last; ++first)
+				m_members.push_back(value_type(first->first, first->second));
+			normalize(false);
+		}
+		FlatMap(std::initializer_list<value_type> members)
+			: FlatMap(members.begin(), members.end())
+		{}
+		// Takes the members as they come (e.g. from a parser), keeping the last of duplicates
+		// if `keep_last` is set.
+		explicit FlatMap(std::vector<value_type> && members, bool keep_last = false)
+			: m_members(std::move(members))
+		{
+			normalize(keep_last);
+		}
+
+		size_t size() const { return m_members.size(); }
+		bool empty() const { return m_members.empty(); }
+
+		iterator begin() { return m_members.begin(); }
+		iterator end() { return m_members.end(); }
+		const_iterator begin() const { return m_members.begin(); }
+		const_iterator end() const { return m_members.end(); }
+
+		iterator find(const std::string & key)
+		{
+			size_t position = find_position(key, hash(key));
+			return position == npos ? end() : begin() + position;
+		}
+		const_iterator find(const std::string & key) const
+		{
+			size_t position = find_position(key, hash(key));
+			return position == npos ? end() : begin() + position;
+		}
+		// Finds a key by its symbol, comparing strings only with the members that have none.
+		const_iterator find(const Key & key) const
+		{
+			size_t position = find_position(key);
+			return position == npos ? end() : begin() + position;
+		}
+		size_t count(const std::string & key) const
+		{
+			return find_position(key, hash(key)) == npos ? 0 : 1;
+		}
+
+		Value & at(const std::string & key)
+		{
+			iterator found = find(key);
+			if (found == end())
+				throw std::out_of_range("no such key: " + key);
+			return found->second;
+		}
+		const Value & at(const std::string & key) const
+		{
+			const_iterator found = find(key);
+			if (found == end())
+				throw std::out_of_range("no such key: " + key);
+			return found->second;
+		}
+
+		Value & operator[](const std::string & key)
+		{
+			return emplace(key, Value()).first->second;
+		}
+
+		std::pair<iterator, bool> insert(const value_type & member)
+		{
+			return emplace(member.first, member.second);
+		}
+		std::pair<iterator, bool> emplace(const std::string & key, Value value)
+		{
+			size_t key_hash = hash(key);
+			size_t position = find_position(key, key_hash);
+			if (position != npos)
+				return std::make_pair(begin() + position, false);
+#ifdef JSON11_INSERTION_ORDER
+			position = m_members.size();
+#else
+			position = std::lower_bound(m_members.begin(), m_members.end(), key,
+				[](const value_type & member, const std::string & k) { return member.first < k; }) - m_members.begin();
+#endif
+			m_members.insert(m_members.begin() + position, value_type(key, std::move(value)));
+			m_hashes.insert(m_hashes.begin() + position, key_hash);
+			m_symbols.insert(m_symbols.begin() + position, SymbolTable::find(key, key_hash));
+			if (position + 1 == m_members.size() && m_members.size() > LinearLimit
+				&& m_index.size() >= 2 * m_members.size())
+			{
+				index_member(position);
+			}
+			else
+			{
+				rebuild_index();
+			}
+			return std::make_pair(begin() + position, true);
+		}
+
+		size_t erase(const std::string & key)
+		{
+			size_t position = find_position(key, hash(key));
+			if (position == npos)
+				return 0;
+			erase(begin() + position);
+			return 1;
+		}
+		iterator erase(const_iterator member)
+		{
+			size_t position = member - m_members.begin();
+			m_members.erase(m_members.begin() + position);
+			m_hashes.erase(m_hashes.begin() + position);
+			m_symbols.erase(m_symbols.begin() + position);
+			rebuild_index();
+			return begin() + position;
+		}
+
+		void clear()
+		{
+			m_members.clear();
+			m_hashes.clear();
+			m_symbols.clear();
+			m_index.clear();
+		}
+		void swap(FlatMap & other)
+		{
+			m_members.swap(other.m_members);
+			m_hashes.swap(other.m_hashes);
+			m_symbols.swap(other.m_symbols);
+			m_index.swap(other.m_index);
+		}
+
+		// Objects compare like std::maps, whatever their iteration order.
+		bool operator==(const FlatMap & other) const
+		{
+			if (size() != other.size())
+				return false;
+#ifdef JSON11_INSERTION_ORDER
+			for (size_t i = 0; i < m_members.size(); ++i)
+			{
+				size_t position = other.find_position(m_members[i].first, m_hashes[i]);
+				if (position == npos || !(other.m_members[position].second == m_members[i].second))
+					return false;
+			}
+			return true;
+#else
+			return m_members == other.m_members;
+#endif
+		}
+		bool operator!=(const FlatMap & other) const { return !(*this == other); }
+		bool operator<(const FlatMap & other) const
+		{
+#ifdef JSON11_INSERTION_ORDER
+			std::vector<const value_type *> own = sorted_members(), others = other.sorted_members();
+			return std::lexicographical_compare(own.begin(), own.end(), others.begin(), others.end(),
+				[](const value_type * lhs, const value_type * rhs) { return *lhs < *rhs; });
+#else
+			return m_members < other.m_members;
+#endif
+		}
+
+	private:
+		static const size_t npos = size_t(-1);
+
+		static size_t hash(const std::string & key)
+		{
+			return key_hash(key);
+		}
+
+		size_t find_position(const std::string & key, size_t key_hash) const
+		{
+			if (m_index.empty())
+			{
+				for (size_t i = 0; i < m_members.size(); ++i)
+				{
+					if (m_hashes[i] == key_hash && m_members[i].first == key)
+						return i;
+				}
+				return npos;
+			}
+			size_t mask = m_index.size() - 1;
+			for (size_t slot = key_hash & mask;; slot = (slot + 1) & mask)
+			{
+				uint32_t entry = m_index[slot];
+				if (!entry)
+					return npos;
+				if (m_hashes[entry - 1] == key_hash && m_members[entry - 1].first == key)
+					return entry - 1;
+			}
+		}
+
+		// A key without symbol is not interned, so no member with a symbol has it. Members
+		// added before their key was interned have no symbol and are compared as strings.
+		size_t find_position(const Key & key) const
+		{
+			if (key.symbol == NoSymbol)
+				return find_position(key.name, key.hash);
+			if (m_index.empty())
+			{
+				for (size_t i = 0; i < m_symbols.size(); ++i)
+				{
+					if (matches(i, key))
+						return i;
+				}
+				return npos;
+			}
+			size_t mask = m_index.size() - 1;
+			for (size_t slot = key.hash & mask;; slot = (slot + 1) & mask)
+			{
+				uint32_t entry = m_index[slot];
+				if (!entry)
+					return npos;
+				if (matches(entry - 1, key))
+					return entry - 1;
+			}
+		}
+		bool matches(size_t position, const Key & key) const
+		{
+			return m_symbols[position] == key.symbol || (m_symbols[position] == NoSymbol
+				&& m_hashes[position] == key.hash && m_members[position].first == key.name);
+		}
+
+		void index_member(size_t position)
+		{
+			size_t mask = m_index.size() - 1;
+			size_t slot = m_hashes[position] & mask;
+			while (m_index[slot])
+				slot = (slot + 1) & mask;
+			m_index[slot] = uint32_t(position + 1);
+		}
+
+		// Tables are at most half full.
+		void rebuild_index()
+		{
+			m_index.clear();
+			if (m_members.size() <= LinearLimit)
+				return;
+			size_t slots = 2 * LinearLimit;
+			while (slots < 2 * m_members.size())
+				slots *= 2;
+			m_index.assign(slots, 0);
+			for (size_t i = 0; i < m_members.size(); ++i)
+				index_member(i);
+		}
+
+		// Orders the members, drops duplicate keys and builds the hashes.
+		void normalize(bool keep_last)
+		{
+#ifdef JSON11_INSERTION_ORDER
+			drop_duplicates(keep_last);
+#else
+			auto by_key = [](const value_type & lhs, const value_type & rhs) { return lhs.first < rhs.first; };
+			if (m_members.size() <= 2 * LinearLimit)
+			{
+				// without the buffer of std::stable_sort
+				for (size_t i = 1; i < m_members.size(); ++i)
+				{
+					if (!by_key(m_members[i], m_members[i - 1]))
+						continue;
+					value_type member = std::move(m_members[i]);
+					size_t j = i;
+					for (; j && by_key(member, m_members[j - 1]); --j)
+						m_members[j] = std::move(m_members[j - 1]);
+					m_members[j] = std::move(member);
+				}
+			}
+			else if (!std::is_sorted(m_members.begin(), m_members.end(), by_key))
+			{
+				std::stable_sort(m_members.begin(), m_members.end(), by_key);
+			}
+			size_t kept = 0;
+			for (size_t i = 0; i < m_members.size(); ++i)
+			{
+				if (kept && m_members[kept - 1].first == m_members[i].first)
+				{
+					if (keep_last)
+						m_members[kept - 1] = std::move(m_members[i]);
+				}
+				else
+				{
+					if (kept != i)
+						m_members[kept] = std::move(m_members[i]);
+					++kept;
+				}
+			}
+			m_members.erase(m_members.begin() + kept, m_members.end());
+#endif
+			m_hashes.resize(m_members.size());
+			m_symbols.resize(m_members.size());
+			for (size_t i = 0; i < m_members.size(); ++i)
+			{
+				m_hashes[i] = hash(m_members[i].first);
+				m_symbols[i] = SymbolTable::find(m_members[i].first, m_hashes[i]);
+			}
+			rebuild_index();
+		}
+
+#ifdef JSON11_INSERTION_ORDER
+		// Keeps the insertion order of the members left.
+		void drop_duplicates(bool keep_last)
+		{
+			std::vector<size_t> order(m_members.size());
+			for (size_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+			std::stable_sort(order.begin(), order.end(),
+				[this](size_t lhs, size_t rhs) { return m_members[lhs].first < m_members[rhs].first; });
+			std::vector<bool> dropped(m_members.size(), false);
+			for (size_t first = 0, last; first < order.size(); first = last)
+			{
+				for (last = first + 1; last < order.size() && m_members[order[last]].first == m_members[order[first]].first; ++last)
+					dropped[keep_last ? order[last - 1] : order[last]] = true;
+			}
+			size_t kept = 0;
+			for (size_t i = 0; i < m_members.size(); ++i)
+			{
+				if (dropped[i])
+					continue;
+				if (kept != i)
+					m_members[kept] = std::move(m_members[i]);
+				++kept;
+			}
+			m_members.erase(m_members.begin() + kept, m_members.end());
+		}
+#endif
+
+		std::vector<const value_type *> sorted_members() const
+		{
+			std::vector<const value_type *> result;
+			for (const value_type & member : m_members)
+				result.push_back(&member);
+			std::sort(result.begin(), result.end(),
+				[](const value_type * lhs, const value_type * rhs) { return lhs->first < rhs->first; });
+			return result;
+		}
+
+		std::vector<value_type> m_members;
+		std::vector<size_t> m_hashes;    // of the members' keys
+		std::vector<Symbol> m_symbols;   // of the members' keys
+		std::vector<uint32_t> m_index;   // member position + 1, 0 for a free slot
+	};
+
+} // namespace json11
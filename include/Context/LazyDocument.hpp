@@ -0,0 +1,170 @@
+/*
+ * LazyDocument.hpp
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <Context/FastParser.hpp>
+#include <Context/FlatMap.hpp>
+#include <Context/StructuralIndex.hpp>
+#include <Context/Symbols.hpp>
+#include <Context/json11.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace json11
+{
+
+	/* LazyDocument
+	 *
+	 * JSON text decoded on demand. The first lookup builds the StructuralIndex of the text; a
+	 * lookup then walks the objects on its path by their keys, stepping over the other
+	 * members through the index, and decodes the value it ends at only. The members of the
+	 * objects walked and the values decoded are kept for later lookups. Lookups may come from
+	 * several threads.
+	 *
+	 * The text is only checked along the paths walked, so an error elsewhere goes unnoticed.
+	 * When a walk meets invalid JSON the whole text is parsed with Json::parse, whose error is
+	 * reported, and lookups use its result from then on.
+	 */
+	class LazyDocument final
+	{
+	public:
+		explicit LazyDocument(std::string text)
+			: m_text(std::move(text)), m_state(UNINDEXED)
+		{}
+		LazyDocument(const LazyDocument &) = delete;
+		LazyDocument & operator=(const LazyDocument &) = delete;
+
+		const std::string & text() const { return m_text; }
+
+		// Whether the value at the path of keys [first, last) from the root exists and is not
+		// null. It is decoded into `out` unless that is null. Sets `err` if the text turns out
+		// not to be valid JSON.
+		bool find(const Key * first, const Key * last, Json * out, std::string & err)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_state == UNINDEXED)
+				m_state = m_index.build(m_text.data(), m_text.size()) ? INDEXED : parse_all();
+			if (m_state == INDEXED)
+			{
+				Walk walked = walk(first, last, out);
+				if (walked != BROKEN)
+					return walked == FOUND;
+				m_state = parse_all();
+			}
+			if (m_state == INVALID)
+			{
+				err = m_error;
+				return false;
+			}
+			const Json * value = &m_parsed;
+			for (; first != last && !value->is_null(); ++first)
+				value = &(*value)[*first];
+			if (value->is_null())
+				return false;
+			if (out)
+				*out = *value;
+			return true;
+		}
+
+	private:
+		enum State { UNINDEXED, INDEXED, PARSED, INVALID };
+		enum Walk { FOUND, MISSING, BROKEN };
+
+		// The character at position `slot` of the index, '\0' past the end of the text.
+		char at(size_t slot) const
+		{
+			return slot < m_index.size() ? m_text[m_index[slot]] : '\0';
+		}
+
+		Walk walk(const Key * first, const Key * last, Json * out)
+		{
+			uint32_t slot = 0;
+			int depth = 0;
+			for (; first != last; ++first, ++depth)
+			{
+				if (at(slot) != '{')
+					return MISSING;
+				const FlatMap<uint32_t> * members = object_members(slot);
+				if (!members)
+					return BROKEN;
+				FlatMap<uint32_t>::const_iterator found = members->find(*first);
+				if (found == members->end())
+					return MISSING;
+				slot = found->second;
+			}
+
+			// containers and strings are only decoded when asked for, scalars to tell null apart
+			char ch = at(slot);
+			if (!out && (ch == '{' || ch == '[' || ch == '"'))
+				return FOUND;
+			auto cached = m_values.find(slot);
+			if (cached == m_values.end())
+			{
+				FastParser parser(m_text, m_index, slot);
+				Json value;
+				if (!parser.parse_value(value, depth))
+					return BROKEN;
+				cached = m_values.insert(std::make_pair(slot, std::move(value))).first;
+			}
+			if (cached->second.is_null())
+				return MISSING;
+			if (out)
+				*out = cached->second;
+			return FOUND;
+		}
+
+		// Keys of the object opening at `slot`, mapped to the slots of their values. Null if
+		// the object is not valid.
+		const FlatMap<uint32_t> * object_members(uint32_t slot)
+		{
+			auto cached = m_objects.find(slot);
+			if (cached != m_objects.end())
+				return &cached->second;
+
+			std::vector<FlatMap<uint32_t>::value_type> members;
+			FastParser parser(m_text, m_index, slot + 1);
+			if (!parser.skip_if('}'))
+			{
+				do
+				{
+					std::string key;
+					if (!parser.parse_key(key))
+						return nullptr;
+					uint32_t value = uint32_t(parser.position());
+					if (!parser.skip_value())
+						return nullptr;
+					members.push_back(FlatMap<uint32_t>::value_type(std::move(key), value));
+				} while (parser.skip_if(','));
+				if (!parser.skip_if('}'))
+					return nullptr;
+			}
+			return &m_objects.insert(std::make_pair(slot, FlatMap<uint32_t>(std::move(members), true))).first->second;
+		}
+
+		State parse_all()
+		{
+			m_parsed = Json::parse(m_text, m_error);
+			m_objects.clear();
+			m_values.clear();
+			return m_error.empty() ? PARSED : INVALID;
+		}
+
+		const std::string m_text;
+		std::mutex m_mutex;
+		State m_state;
+		StructuralIndex m_index;
+		std::unordered_map<uint32_t, FlatMap<uint32_t>> m_objects;  // by slot of their '{'
+		std::unordered_map<uint32_t, Json> m_values;                // by slot
+		Json m_parsed;                                              // once PARSED
+		std::string m_error;                                        // once INVALID
+	};
+
+} // namespace json11
@@ -0,0 +1,237 @@
+/*
+ * Projection.hpp
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <Context/FastParser.hpp>
+#include <Context/FlatMap.hpp>
+#include <Context/StructuralIndex.hpp>
+#include <Context/json11.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace json11
+{
+
+	/* Projection
+	 *
+	 * The parts of JSON values reached by a set of dotted paths, where "*" stands for every
+	 * item of an array or member of an object. A value a path ends at is kept whole; objects
+	 * and arrays on the way only keep what the paths going through them reach.
+	 *
+	 * parse() projects JSON text in one walk of its StructuralIndex: what is not kept is
+	 * checked, but nothing of it is decoded or allocated. Invalid JSON is handed to Json::parse,
+	 * so errors are reported with the same messages.
+	 */
+	class Projection final
+	{
+	public:
+		// Keeps everything.
+		Projection()
+			: m_nodes(1)
+		{
+			m_nodes[0].kept = true;
+		}
+		template <class InputIterator>
+		Projection(InputIterator first, InputIterator last)
+			: m_nodes(1)
+		{
+			for (; first != last; ++first)
+				add(*first);
+		}
+
+		Json parse(const std::string & in, std::string & err) const
+		{
+			const Nodes root(1, 0);
+			StructuralIndex index;
+			if (index.build(in.data(), in.size()))
+			{
+				FastParser parser(in, index);
+				Json result;
+				if (project(parser, root, result, 0) && parser.at_end())
+					return result;
+			}
+			Json parsed = Json::parse(in, err);
+			return err.empty() ? project(parsed, root) : parsed;
+		}
+
+		Json apply(const Json & value) const
+		{
+			return project(value, Nodes(1, 0));
+		}
+
+	private:
+		// The trie of the paths. Child 0 stands for none, the root being no one's child.
+		struct Node
+		{
+			Node() : star(0), kept(false) {}
+
+			FlatMap<uint32_t> children;
+			uint32_t star;
+			bool kept;
+		};
+		// The nodes a value is reached by: a member can match a key and a "*".
+		typedef std::vector<uint32_t> Nodes;
+
+		void add(const std::string & path)
+		{
+			uint32_t node = 0;
+			size_t start = 0, dot;
+			do
+			{
+				dot = path.find('.', start);
+				std::string segment = path.substr(start, dot - start);
+				uint32_t child = segment == "*" ? m_nodes[node].star : 0;
+				if (segment != "*")
+				{
+					FlatMap<uint32_t>::const_iterator found = m_nodes[node].children.find(segment);
+					if (found != m_nodes[node].children.end())
+						child = found->second;
+				}
+				if (!child)
+				{
+					child = uint32_t(m_nodes.size());
+					m_nodes.push_back(Node());
+					if (segment == "*")
+						m_nodes[node].star = child;
+					else
+						m_nodes[node].children.emplace(segment, child);
+				}
+				node = child;
+				start = dot + 1;
+			} while (dot != std::string::npos);
+			m_nodes[node].kept = true;
+		}
+
+		bool kept(const Nodes & nodes) const
+		{
+			for (uint32_t node : nodes)
+			{
+				if (m_nodes[node].kept)
+					return true;
+			}
+			return false;
+		}
+		void members(const Nodes & nodes, const std::string & key, Nodes & reached) const
+		{
+			reached.clear();
+			for (uint32_t node : nodes)
+			{
+				FlatMap<uint32_t>::const_iterator found = m_nodes[node].children.find(key);
+				if (found != m_nodes[node].children.end())
+					reached.push_back(found->second);
+				if (m_nodes[node].star)
+					reached.push_back(m_nodes[node].star);
+			}
+		}
+		void items(const Nodes & nodes, Nodes & reached) const
+		{
+			reached.clear();
+			for (uint32_t node : nodes)
+			{
+				if (m_nodes[node].star)
+					reached.push_back(m_nodes[node].star);
+			}
+		}
+
+		bool project(FastParser & parser, const Nodes & nodes, Json & out, int depth) const
+		{
+			if (kept(nodes) || depth > max_depth)
+				return parser.parse_value(out, depth);
+
+			Nodes reached;
+			if (parser.skip_if('{'))
+			{
+				std::vector<Json::object::value_type> members;
+				if (!parser.skip_if('}'))
+				{
+					do
+					{
+						std::string key;
+						if (!parser.parse_key(key))
+							return false;
+						this->members(nodes, key, reached);
+						if (reached.empty())
+						{
+							if (!parser.check_value(depth + 1))
+								return false;
+							continue;
+						}
+						Json value;
+						if (!project(parser, reached, value, depth + 1))
+							return false;
+						members.push_back(Json::object::value_type(std::move(key), std::move(value)));
+					} while (parser.skip_if(','));
+					if (!parser.skip_if('}'))
+						return false;
+				}
+				out = Json::object(std::move(members), true);
+				return true;
+			}
+			if (parser.skip_if('['))
+			{
+				Json::array values;
+				if (!parser.skip_if(']'))
+				{
+					items(nodes, reached);
+					do
+					{
+						if (reached.empty())
+						{
+							if (!parser.check_value(depth + 1))
+								return false;
+							continue;
+						}
+						values.push_back(Json());
+						if (!project(parser, reached, values.back(), depth + 1))
+							return false;
+					} while (parser.skip_if(','));
+					if (!parser.skip_if(']'))
+						return false;
+				}
+				out = std::move(values);
+				return true;
+			}
+			return parser.parse_value(out, depth);
+		}
+
+		Json project(const Json & value, const Nodes & nodes) const
+		{
+			if (kept(nodes))
+				return value;
+
+			Nodes reached;
+			if (value.is_object())
+			{
+				std::vector<Json::object::value_type> members;
+				for (const Json::object::value_type & member : value.object_items())
+				{
+					this->members(nodes, member.first, reached);
+					if (!reached.empty())
+						members.push_back(Json::object::value_type(member.first, project(member.second, reached)));
+				}
+				return Json::object(std::move(members));
+			}
+			if (value.is_array())
+			{
+				Json::array values;
+				items(nodes, reached);
+				if (!reached.empty())
+				{
+					for (const Json & item : value.array_items())
+						values.push_back(project(item, reached));
+				}
+				return values;
+			}
+			return value;
+		}
+
+		std::vector<Node> m_nodes;
+	};
+
+} // namespace json11
@@ -0,0 +1,289 @@
+/*
+ * ReadSet.h
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <Context/json11.hpp>
+#include <Context/Context.hpp>
+#include <Context/Projection.hpp>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace GreenZone
+{
+	// Context paths a compiled template may read. Collected statically from the node
+	// expressions: loop variables are mapped back onto their containers, and "*" stands
+	// for every item of an array or every member of an object.
+	class ReadSet
+	{
+	public:
+		typedef std::vector< std::string > Segments;
+
+		ReadSet()
+			: m_complete(true)
+		{}
+
+		void add(std::string const & path)
+		{
+			Segments segments = split(path);
+			if (segments.empty() || !bind(segments))
+			{
+				return;
+			}
+			insert(segments);
+		}
+
+		// `container` is the loop container expression if it is a plain path, empty otherwise.
+		void enterLoop(std::vector< std::string > const & vars, std::string const & container)
+		{
+			Scope scope;
+			scope.vars = vars;
+			scope.used = false;
+			if (container.size())
+			{
+				scope.container = split(container);
+				if (!bind(scope.container))
+				{
+					scope.container.clear();
+				}
+			}
+			m_scopes.push_back(scope);
+		}
+		void exitLoop()
+		{
+			Scope scope = m_scopes.back();
+			m_scopes.pop_back();
+			// the loop body does not look at the items, but the output still depends on their count
+			if (!scope.used && scope.container.size())
+			{
+				insert(scope.container);
+			}
+		}
+
+		// The template reads something that can not be determined statically (e.g. includes).
+		void markIncomplete()
+		{
+			m_complete = false;
+		}
+		bool complete() const
+		{
+			return m_complete;
+		}
+
+		std::set< std::string > const & paths() const
+		{
+			return m_paths;
+		}
+
+		// Keeps the values of the paths, everything if the set is not complete.
+		json11::Projection projection() const
+		{
+			return m_complete ? json11::Projection(m_paths.begin(), m_paths.end()) : json11::Projection();
+		}
+
+		void merge(ReadSet const & other)
+		{
+			for (auto const & path : other.m_segments)
+			{
+				insert(path);
+			}
+			m_complete = m_complete && other.m_complete;
+		}
+
+		// Whether a change at `path` (concrete, dot separated) may affect what the template reads.
+		bool touches(std::string const & path) const
+		{
+			if (!m_complete)
+			{
+				return true;
+			}
+			Segments changed = split(path);
+			for (auto const & segments : m_segments)
+			{
+				size_t common = std::min(segments.size(), changed.size());
+				size_t i = 0;
+				while (i < common && (segments[i] == "*" || segments[i] == changed[i]))
+				{
+					++i;
+				}
+				if (i == common)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Every value the template may read in `context`, serialized: two contexts with the
+		// same key render the same output. Only meaningful if the set is complete.
+		std::string key(Context const & context) const
+		{
+			std::string result;
+			for (auto const & segments : m_segments)
+			{
+				walk(context.member(segments[0]), segments, 1, result);
+			}
+			return result;
+		}
+
+		virtual ~ReadSet(){}
+
+	protected:
+		struct Scope
+		{
+			std::vector< std::string > vars;
+			Segments container;
+			bool used;
+		};
+
+		static Segments split(std::string const & path)
+		{
+			Segments result;
+			size_t start = 0, dot;
+			while ((dot = path.find('.', start)) != std::string::npos)
+			{
+				result.push_back(path.substr(start, dot - start));
+				start = dot + 1;
+			}
+			result.push_back(path.substr(start));
+			if (std::find(result.begin(), result.end(), "") != result.end())
+			{
+				result.clear();
+			}
+			return result;
+		}
+
+		static std::string join(Segments const & segments)
+		{
+			std::string result;
+			for (auto const & segment : segments)
+			{
+				if (result.size())
+				{
+					result.push_back('.');
+				}
+				result += segment;
+			}
+			return result;
+		}
+
+		// Rewrites a path starting with a loop variable in terms of the loop container.
+		// Returns false if the path is already covered by a non-path container expression.
+		bool bind(Segments & segments)
+		{
+			for (auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); ++scope)
+			{
+				if (std::find(scope->vars.begin(), scope->vars.end(), segments[0]) == scope->vars.end())
+				{
+					continue;
+				}
+				scope->used = true;
+				if (scope->container.empty())
+				{
+					return false;
+				}
+				Segments bound = scope->container;
+				bound.push_back("*");
+				bound.insert(bound.end(), segments.begin() + 1, segments.end());
+				segments = bound;
+				return true;
+			}
+			return true;
+		}
+
+		static bool covers(Segments const & general, Segments const & particular)
+		{
+			if (general.size() > particular.size())
+			{
+				return false;
+			}
+			for (size_t i = 0; i < general.size(); ++i)
+			{
+				if (general[i] != "*" && general[i] != particular[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void insert(Segments const & segments)
+		{
+			for (auto const & existing : m_segments)
+			{
+				if (covers(existing, segments))
+				{
+					return;
+				}
+			}
+			for (auto i = m_segments.begin(); i != m_segments.end();)
+			{
+				if (covers(segments, *i))
+				{
+					m_paths.erase(join(*i));
+					i = m_segments.erase(i);
+				}
+				else
+				{
+					++i;
+				}
+			}
+			m_segments.push_back(segments);
+			m_paths.insert(join(segments));
+		}
+
+		// Values are dumped as JSON, which has no raw newline, so the key reads back unambiguously.
+		static void append(std::string & key, std::string const & token)
+		{
+			key += token;
+			key.push_back('\n');
+		}
+
+		static void walk(json11::Json const & json, Segments const & segments, size_t index, std::string & key)
+		{
+			if (index == segments.size())
+			{
+				append(key, json.dump());
+				return;
+			}
+			if (segments[index] != "*")
+			{
+				walk(json[segments[index]], segments, index + 1, key);
+				return;
+			}
+			if (json.is_array())
+			{
+				append(key, "[" + std::to_string(json.array_items().size()));
+				for (auto const & item : json.array_items())
+				{
+					walk(item, segments, index + 1, key);
+				}
+			}
+			else if (json.is_object())
+			{
+				append(key, "{" + std::to_string(json.object_items().size()));
+				for (auto const & item : json.object_items())
+				{
+					append(key, json11::Json(item.first).dump());
+					walk(item.second, segments, index + 1, key);
+				}
+			}
+			else
+			{
+				append(key, json.dump());
+			}
+		}
+
+	protected:
+		std::vector< Scope > m_scopes;
+		std::vector< Segments > m_segments;
+		std::set< std::string > m_paths;
+		bool m_complete;
+	};
+
+} /* namespace RedZone */
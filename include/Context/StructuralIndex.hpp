@@ -0,0 +1,221 @@
+/*
+ * StructuralIndex.hpp
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON11_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace json11
+{
+
+	inline int trailing_zeros(uint64_t bits)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return int(index);
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, uint32_t(bits)))
+			return int(index);
+		_BitScanForward(&index, uint32_t(bits >> 32));
+		return int(index) + 32;
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+	inline int population_count(uint64_t bits)
+	{
+#ifdef _MSC_VER
+		bits -= (bits >> 1) & 0x5555555555555555ULL;
+		bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+		bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return int((bits * 0x0101010101010101ULL) >> 56);
+#else
+		return __builtin_popcountll(bits);
+#endif
+	}
+
+	/* StructuralIndex
+	 *
+	 * Positions of the characters a JSON parser stops at: brackets, braces, colons and commas
+	 * outside strings, opening quotes and the first character of other values, followed by the
+	 * input size. The input is classified 64 bytes at a time (with SSE2 when available) into
+	 * bitmasks; escaped quotes are found with carries through the runs of backslashes and the
+	 * inside of strings with a prefix xor of the quotes, so no byte is branched on.
+	 *
+	 * build() fails on an unterminated string or an unescaped control character in a string;
+	 * checking the rest of the grammar is left to the parser walking the positions.
+	 */
+	class StructuralIndex final
+	{
+	public:
+		bool build(const char * data, size_t size)
+		{
+			m_positions.clear();
+			if (size >= UINT32_MAX)
+				return false;
+			m_positions.reserve(size / 8 + 16);
+
+			State state = State();
+			size_t offset = 0;
+			for (; offset + 64 <= size; offset += 64)
+			{
+				if (!index_block(data + offset, uint32_t(offset), state))
+					return false;
+			}
+			if (offset < size)
+			{
+				char last[64];
+				memset(last, ' ', sizeof last);
+				memcpy(last, data + offset, size - offset);
+				if (!index_block(last, uint32_t(offset), state))
+					return false;
+			}
+			if (state.in_string)
+				return false;
+			m_positions.push_back(uint32_t(size));
+			return true;
+		}
+
+		// Including the final input size.
+		size_t size() const { return m_positions.size(); }
+		uint32_t operator[](size_t i) const { return m_positions[i]; }
+
+	private:
+		// Carried from a block to the next one.
+		struct State
+		{
+			uint64_t escaped;     // 1 if the first byte is escaped
+			uint64_t in_string;   // all ones if the block starts inside a string
+			uint64_t in_scalar;   // 1 if the block starts in the middle of a value
+		};
+
+		struct Masks
+		{
+			uint64_t quotes;
+			uint64_t backslashes;
+			uint64_t operators;
+			uint64_t whitespace;
+			uint64_t controls;
+		};
+
+		static void classify(const char * block, Masks & masks)
+		{
+			masks = Masks();
+#ifdef JSON11_SSE2
+			const __m128i control_limit = _mm_set1_epi8(0x1F);
+			for (int i = 0; i < 4; ++i)
+			{
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+				auto equal = [&](char c) { return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)); };
+				auto bits = [i](__m128i matches) { return uint64_t(uint16_t(_mm_movemask_epi8(matches))) << (16 * i); };
+
+				masks.quotes |= bits(equal('"'));
+				masks.backslashes |= bits(equal('\\'));
+				masks.operators |= bits(_mm_or_si128(_mm_or_si128(_mm_or_si128(equal('{'), equal('}')),
+					_mm_or_si128(equal('['), equal(']'))), _mm_or_si128(equal(':'), equal(','))));
+				masks.whitespace |= bits(_mm_or_si128(_mm_or_si128(equal(' '), equal('\t')),
+					_mm_or_si128(equal('\n'), equal('\r'))));
+				masks.controls |= bits(_mm_cmpeq_epi8(_mm_min_epu8(bytes, control_limit), bytes));
+			}
+#else
+			for (int i = 0; i < 64; ++i)
+			{
+				uint64_t bit = uint64_t(1) << i;
+				unsigned char c = block[i];
+				switch (c)
+				{
+				case '"': masks.quotes |= bit; break;
+				case '\\': masks.backslashes |= bit; break;
+				case '{': case '}': case '[': case ']': case ':': case ',': masks.operators |= bit; break;
+				case ' ': masks.whitespace |= bit; break;
+				case '\t': case '\n': case '\r': masks.whitespace |= bit; masks.controls |= bit; break;
+				default:
+					if (c < 0x20)
+						masks.controls |= bit;
+				}
+			}
+#endif
+		}
+
+		// Bytes preceded by an odd number of backslashes.
+		static uint64_t escaped_bytes(uint64_t backslashes, uint64_t & carry)
+		{
+			const uint64_t odd_bits = 0xAAAAAAAAAAAAAAAAULL;
+			if (!backslashes)
+			{
+				uint64_t escaped = carry;
+				carry = 0;
+				return escaped;
+			}
+			// subtracting the start of each run of backslashes from the odd bits flips the
+			// run's parity bits up to its end: what remains set outside the backslashes marks
+			// the bytes after odd-length runs
+			uint64_t starts = backslashes & ~carry;
+			uint64_t series = ((starts << 1) | odd_bits) - starts;
+			uint64_t codes = series ^ odd_bits;
+			uint64_t escaped = codes ^ (backslashes | carry);
+			carry = (codes & backslashes) >> 63;
+			return escaped;
+		}
+
+		static uint64_t prefix_xor(uint64_t bits)
+		{
+			bits ^= bits << 1;
+			bits ^= bits << 2;
+			bits ^= bits << 4;
+			bits ^= bits << 8;
+			bits ^= bits << 16;
+			bits ^= bits << 32;
+			return bits;
+		}
+
+		bool index_block(const char * block, uint32_t offset, State & state)
+		{
+			Masks masks;
+			classify(block, masks);
+
+			uint64_t quotes = masks.quotes & ~escaped_bytes(masks.backslashes, state.escaped);
+			// opening quotes and string contents, not closing quotes
+			uint64_t in_string = prefix_xor(quotes) ^ state.in_string;
+			state.in_string = 0 - (in_string >> 63);
+			if (masks.controls & in_string)
+				return false;
+
+			uint64_t scalars = ~(masks.operators | masks.whitespace);
+			uint64_t unquoted = scalars & ~quotes;
+			uint64_t starts = scalars & ~((unquoted << 1) | state.in_scalar);
+			state.in_scalar = unquoted >> 63;
+			uint64_t structurals = (masks.operators | starts) & ~(in_string ^ quotes);
+			if (!structurals)
+				return true;
+
+			size_t count = m_positions.size();
+			m_positions.resize(count + population_count(structurals));
+			uint32_t * position = &m_positions[count];
+			do
+			{
+				*position++ = offset + trailing_zeros(structurals);
+				structurals &= structurals - 1;
+			} while (structurals);
+			return true;
+		}
+
+		std::vector<uint32_t> m_positions;
+	};
+
+} // namespace json11
@@ -0,0 +1,167 @@
+/*
+ * Symbols.hpp
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace json11
+{
+
+	typedef uint32_t Symbol;
+	static const Symbol NoSymbol = 0;
+
+	inline size_t key_hash(const std::string & key)
+	{
+		return std::hash<std::string>()(key);
+	}
+
+	/* SymbolTable
+	 *
+	 * Process-wide numbering of the keys known in advance (see Key): objects store the symbol
+	 * of each of their keys that has one, so such a key is found by comparing numbers. Only
+	 * intern() numbers keys; object keys are only looked up with find(), which takes no lock,
+	 * so the keys of the data never fill the table. Symbols are never released; once
+	 * MaxSymbols keys are known, new keys get NoSymbol and are only compared as strings.
+	 */
+	class SymbolTable final
+	{
+	public:
+		enum { MaxSymbols = 1 << 20 };
+
+		// The symbol of `key`, numbering it if it is new. Takes a lock.
+		static Symbol intern(const std::string & key, size_t hash)
+		{
+			Symbol symbol = find(key, hash);
+			if (symbol != NoSymbol)
+				return symbol;
+
+			State & state = shared_state();
+			std::lock_guard<std::mutex> lock(state.mutex);
+			Table * table = state.current.load(std::memory_order_relaxed);
+			symbol = table->find(key, hash);
+			if (symbol != NoSymbol || state.entries.size() >= MaxSymbols)
+				return symbol;
+			if (2 * (state.entries.size() + 1) > table->size())
+			{
+				// readers may still probe the old table, which is kept: the tables before the
+				// current one take less memory than it
+				state.tables.push_back(std::unique_ptr<Table>(new Table(2 * table->size())));
+				table = state.tables.back().get();
+				for (const Entry & entry : state.entries)
+					table->insert(&entry);
+			}
+			Entry entry = { key, hash, Symbol(state.entries.size() + 1) };
+			state.entries.push_back(entry);
+			table->insert(&state.entries.back());
+			state.current.store(table, std::memory_order_release);
+			state.count.store(state.entries.size(), std::memory_order_relaxed);
+			return entry.symbol;
+		}
+
+		// The symbol of `key`, NoSymbol if it has not been interned. Takes no lock.
+		static Symbol find(const std::string & key, size_t hash)
+		{
+			return shared_state().current.load(std::memory_order_acquire)->find(key, hash);
+		}
+
+		// Number of keys interned so far.
+		static size_t size()
+		{
+			return shared_state().count.load(std::memory_order_relaxed);
+		}
+
+	private:
+		struct Entry
+		{
+			std::string key;
+			size_t hash;
+			Symbol symbol;
+		};
+
+		// Open addressing table of entries, at most half full. Entries are only added, so a
+		// reader sees either a slot's entry or an empty slot.
+		class Table
+		{
+		public:
+			explicit Table(size_t size)
+				: m_mask(size - 1), m_slots(new std::atomic<const Entry *>[size])
+			{
+				for (size_t i = 0; i < size; ++i)
+					m_slots[i].store(nullptr, std::memory_order_relaxed);
+			}
+
+			size_t size() const { return m_mask + 1; }
+
+			Symbol find(const std::string & key, size_t hash) const
+			{
+				for (size_t slot = hash & m_mask;; slot = (slot + 1) & m_mask)
+				{
+					const Entry * entry = m_slots[slot].load(std::memory_order_acquire);
+					if (!entry)
+						return NoSymbol;
+					if (entry->hash == hash && entry->key == key)
+						return entry->symbol;
+				}
+			}
+
+			void insert(const Entry * entry)
+			{
+				size_t slot = entry->hash & m_mask;
+				while (m_slots[slot].load(std::memory_order_relaxed))
+					slot = (slot + 1) & m_mask;
+				m_slots[slot].store(entry, std::memory_order_release);
+			}
+
+		private:
+			size_t m_mask;
+			std::unique_ptr<std::atomic<const Entry *>[]> m_slots;
+		};
+
+		struct State
+		{
+			State()
+				: count(0)
+			{
+				tables.push_back(std::unique_ptr<Table>(new Table(1024)));
+				current.store(tables.back().get(), std::memory_order_relaxed);
+			}
+
+			std::mutex mutex;
+			std::atomic<Table *> current;
+			std::atomic<size_t> count;
+			std::vector<std::unique_ptr<Table>> tables;
+			std::deque<Entry> entries;  // stable addresses, referenced by the tables
+		};
+
+		static State & shared_state()
+		{
+			static State s_state;
+			return s_state;
+		}
+	};
+
+	// A key looked up repeatedly, e.g. a path segment of a compiled template: its hash and
+	// symbol are computed once.
+	struct Key
+	{
+		explicit Key(std::string key)
+			: name(std::move(key)), hash(key_hash(name)), symbol(SymbolTable::intern(name, hash))
+		{}
+
+		std::string name;
+		size_t hash;
+		Symbol symbol;
+	};
+
+} // namespace json11
@@ -4,27 +4,22 @@
  *
  * The core object provided by the library is json11::Json. A Json object represents any JSON
  * value: null, bool, number (int or double), string (std::string), array (std::vector), or
- * object (std::map).
+ * object (FlatMap, a std::map-like sorted vector).
  *
  * Json objects act like values: they can be assigned, copied, moved, compared for equality or
  * order, etc. There are also helper methods Json::dump, to serialize a Json to a string, and
  * Json::parse (static) to parse a std::string as a Json object.
  *
- * Internally, the various types of Json object are represented by the JsonValue class
- * hierarchy.
+ * Internally, null, booleans and numbers are stored in the Json itself, and strings, arrays
+ * and objects are represented by the JsonValue class hierarchy.
  *
  * A note on numbers - JSON specifies the syntax of number formatting but not its semantics,
  * so some JSON implementations distinguish between integers and floating-point numbers, while
- * some don't. In json11, we choose the latter. Because some JSON implementations (namely
- * Javascript itself) treat all numbers as the same type, distinguishing the two leads
- * to JSON that will be *silently* changed by a round-trip through those implementations.
- * Dangerous! To avoid that risk, json11 stores all numbers as double internally, but also
- * provides integer helpers.
- *
- * Fortunately, double-precision IEEE754 ('double') can precisely store any integer in the
- * range +/-2^53, which includes every 'int' on most systems. (Timestamps often use int64
- * or long long to avoid the Y2038K problem; a double storing microseconds since some epoch
- * will be exact for +/- 275 years.)
+ * some don't. json11 exposes a single NUMBER type, since some implementations (namely
+ * Javascript itself) treat all numbers as the same type. Numbers parsed or constructed from
+ * an integer are however kept exactly as a 64-bit integer (is_integer(), integer_value()),
+ * beyond the +/-2^53 a double can represent exactly, and are compared and serialized as
+ * such; other numbers are stored as double. number_value() converts either to a double.
  */
 
 /* Copyright (c) 2013 Dropbox, Inc.
@@ -53,8 +48,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <Context/FlatMap.hpp>
 #include <memory>
 #include <initializer_list>
+#include <atomic>
+#include <cstddef>
+#include <utility>
 
 #ifdef _MSC_VER
 #define JSON11_NOEXCEPT
@@ -66,6 +65,21 @@ namespace json11
 {
 	class JsonValue;
 
+	/* Reference counting
+	 *
+	 * JsonValue objects carry their own reference count. It is atomic unless
+	 * JSON11_NONATOMIC_REFCOUNT is defined, which makes copying a Json cheaper but requires
+	 * every value to be used by one thread only.
+	 */
+#ifdef JSON11_NONATOMIC_REFCOUNT
+	typedef long RefCount;
+#else
+	typedef std::atomic<long> RefCount;
+#endif
+
+	template <class T, class... Args>
+	inline JsonValue * make_value(Args &&... args);
+
 	class Json final
 	{
 	public:
@@ -77,13 +91,14 @@ namespace json11
 
 		// Array and object typedefs
 		typedef std::vector<Json> array;
-		typedef std::map<std::string, Json> object;
+		typedef FlatMap<Json> object;
 
 		// Constructors for the various types of JSON value.
 		inline Json() JSON11_NOEXCEPT;                // NUL
 		inline Json(std::nullptr_t) JSON11_NOEXCEPT;  // NUL
 		inline Json(double value);                    // NUMBER
 		inline Json(int value);                       // NUMBER
+		inline Json(long long value);                 // NUMBER
 		inline Json(bool value);                      // BOOL
 		inline Json(const std::string &value);        // STRING
 		inline Json(std::string &&value);             // STRING
@@ -124,25 +139,31 @@ namespace json11
 		inline bool is_array()  const { return type() == ARRAY; }
 		inline bool is_object() const { return type() == OBJECT; }
 
-		// Return the enclosed value if this is a number, 0 otherwise. Note that json11 does not
-		// distinguish between integer and non-integer numbers - number_value() and int_value()
-		// can both be applied to a NUMBER-typed object.
+		// Return the enclosed value if this is a number, 0 otherwise. number_value() and
+		// int_value() can both be applied to any NUMBER-typed object, integer or not.
 		inline double number_value() const;
 		inline int int_value() const;
 
+		// Numbers parsed or constructed from an integer keep it exactly (64 bits); parsed
+		// integers beyond the long long range become doubles. integer_value() truncates
+		// other numbers.
+		inline bool is_integer() const;
+		inline long long integer_value() const;
+
 		// Return the enclosed value if this is a boolean, false otherwise.
 		inline bool bool_value() const;
 		// Return the enclosed string if this is a string, "" otherwise.
 		inline const std::string &string_value() const;
 		// Return the enclosed std::vector if this is an array, or an empty vector otherwise.
 		inline const array &array_items() const;
-		// Return the enclosed std::map if this is an object, or an empty map otherwise.
+		// Return the enclosed object if this is an object, or an empty one otherwise.
 		inline const object &object_items() const;
 
 		// Return a reference to arr[i] if this is an array, Json() otherwise.
 		inline const Json & operator[](size_t i) const;
 		// Return a reference to obj[key] if this is an object, Json() otherwise.
 		inline const Json & operator[](const std::string &key) const;
+		inline const Json & operator[](const Key &key) const;
 
 		// Serialize.
 		inline void dump(std::string &out) const;
@@ -170,6 +191,16 @@ namespace json11
 		// Parse multiple objects, concatenated or separated by whitespace
 		inline static std::vector<Json> parse_multi(const std::string & in, std::string & err);
 
+		inline Json(const Json & other) JSON11_NOEXCEPT;
+		inline Json(Json && other) JSON11_NOEXCEPT;
+		Json & operator=(Json other) JSON11_NOEXCEPT
+		{
+			std::swap(m_data, other.m_data);
+			std::swap(m_storage, other.m_storage);
+			return *this;
+		}
+		inline ~Json();
+
 		inline bool operator== (const Json &rhs) const;
 		inline bool operator<  (const Json &rhs) const;
 		bool operator!= (const Json &rhs) const { return !(*this == rhs); }
@@ -186,7 +217,21 @@ namespace json11
 		inline bool has_shape(const shape & types, std::string & err) const;
 
 	private:
-		std::shared_ptr<JsonValue> m_ptr;
+		// A Json takes 16 bytes: null, booleans and numbers are stored inline, strings,
+		// arrays and objects in a reference counted JsonValue.
+		enum Storage : unsigned char
+		{
+			NULL_STORAGE, BOOL_STORAGE, DOUBLE_STORAGE, INTEGER_STORAGE, VALUE_STORAGE
+		};
+		union Data
+		{
+			double number;
+			long long integer;  // also the value of a boolean
+			JsonValue * value;
+		};
+
+		Data m_data;
+		Storage m_storage;
 	};
 
 	// Internal class hierarchy - JsonValue objects are not exposed to users of this API.
@@ -194,21 +239,26 @@ namespace json11
 	{
 	protected:
 		friend class Json;
-		friend class JsonInt;
-		friend class JsonDouble;
 		virtual Json::Type type() const = 0;
 		virtual bool equals(const JsonValue * other) const = 0;
 		virtual bool less(const JsonValue * other) const = 0;
 		virtual void dump(std::string &out) const = 0;
-		inline virtual double number_value() const;
-		inline virtual int int_value() const;
-		inline virtual bool bool_value() const;
 		inline virtual const std::string &string_value() const;
 		inline virtual const Json::array &array_items() const;
 		inline virtual const Json &operator[](size_t i) const;
 		inline virtual const Json::object &object_items() const;
 		inline virtual const Json &operator[](const std::string &key) const;
+		inline virtual const Json &operator[](const Key &key) const;
 		virtual ~JsonValue() {}
+
+		JsonValue() : m_refs(1) {}
+		JsonValue(const JsonValue &) = delete;
+		JsonValue & operator=(const JsonValue &) = delete;
+
+		template <class T, class... Args>
+		friend JsonValue * make_value(Args &&... args);
+
+		mutable RefCount m_refs;
 	};
 
 } // namespace json11
@@ -20,9 +20,11 @@
  */
 
 #include <cassert>
+#include <cerrno>
 #include <cstdlib>
 #include <cstdio>
 #include <limits>
+#include <new>
 
 #ifdef _MSC_VER
 #define snprintf _snprintf
@@ -49,9 +51,9 @@ namespace json11
 		out += buf;
 	}
 
-	inline static void dump(int value, std::string &out) {
+	inline static void dump(long long value, std::string &out) {
 		char buf[32];
-		snprintf(buf, sizeof buf, "%d", value);
+		snprintf(buf, sizeof buf, "%lld", value);
 		out += buf;
 	}
 
@@ -152,7 +154,24 @@ namespace json11
 
 	void Json::dump(std::string &out) const
 	{
-		m_ptr->dump(out);
+		switch (m_storage)
+		{
+		case NULL_STORAGE:
+			json11::dump(nullptr, out);
+			break;
+		case BOOL_STORAGE:
+			json11::dump(m_data.integer != 0, out);
+			break;
+		case DOUBLE_STORAGE:
+			json11::dump(m_data.number, out);
+			break;
+		case INTEGER_STORAGE:
+			json11::dump(m_data.integer, out);
+			break;
+		case VALUE_STORAGE:
+			m_data.value->dump(out);
+			break;
+		}
 	}
 
 	/* * * * * * * * * * * * * * * * * * * *
@@ -188,33 +207,6 @@ namespace json11
 		void dump(std::string &out) const { json11::dump(m_value, out); }
 	};
 
-	class JsonDouble final : public Value<Json::NUMBER, double>
-	{
-		double number_value() const { return m_value; }
-		int int_value() const { return int(m_value); }
-		bool equals(const JsonValue * other) const { return m_value == other->number_value(); }
-		bool less(const JsonValue * other)   const { return m_value < other->number_value(); }
-	public:
-		JsonDouble(double value) : Value(value) {}
-	};
-
-	class JsonInt final : public Value<Json::NUMBER, int>
-	{
-		double number_value() const { return m_value; }
-		int int_value() const { return m_value; }
-		bool equals(const JsonValue * other) const { return m_value == other->number_value(); }
-		bool less(const JsonValue * other)   const { return m_value < other->number_value(); }
-	public:
-		JsonInt(double value) : Value(int(value)) {}
-	};
-
-	class JsonBoolean final : public Value<Json::BOOL, bool>
-	{
-		bool bool_value() const { return m_value; }
-	public:
-		JsonBoolean(bool value) : Value(value) {}
-	};
-
 	class JsonString final : public Value<Json::STRING, std::string>
 	{
 		const std::string &string_value() const { return m_value; }
@@ -236,28 +228,20 @@ namespace json11
 	{
 		const Json::object &object_items() const { return m_value; }
 		inline const Json & operator[](const std::string &key) const;
+		inline const Json & operator[](const Key &key) const;
 	public:
 		JsonObject(const Json::object &value) : Value(value) {}
 		JsonObject(Json::object &&value) : Value(std::move(value)) {}
 	};
 
-	class JsonNull final : public Value<Json::NUL, std::nullptr_t>
-	{
-	public:
-		JsonNull() : Value(nullptr) {}
-	};
-
 	/* * * * * * * * * * * * * * * * * * * *
 	 * Static globals - static-init-safe
 	 */
 	struct Statics
 	{
-		const std::shared_ptr<JsonValue> null = std::make_shared<JsonNull>();
-		const std::shared_ptr<JsonValue> t = std::make_shared<JsonBoolean>(true);
-		const std::shared_ptr<JsonValue> f = std::make_shared<JsonBoolean>(false);
 		const std::string empty_string;
 		const std::vector<Json> empty_vector;
-		const std::map<std::string, Json> empty_map;
+		const Json::object empty_map;
 		Statics() {}
 	};
 
@@ -269,56 +253,140 @@ namespace json11
 
 	inline const Json & static_null()
 	{
-		// This has to be separate, not in Statics, because Json() accesses statics().null.
 		static const Json json_null;
 		return json_null;
 	}
 
+	/* * * * * * * * * * * * * * * * * * * *
+	 * Reference counting
+	 */
+
+	inline void add_ref(long &refs) { ++refs; }
+	inline bool drop_ref(long &refs) { return !--refs; }
+	inline void add_ref(std::atomic<long> &refs) { refs.fetch_add(1, std::memory_order_relaxed); }
+	inline bool drop_ref(std::atomic<long> &refs) { return refs.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+	static_assert(sizeof(Json) <= 16, "Json values are expected to take 16 bytes");
+
+	Json::Json(const Json & other) JSON11_NOEXCEPT : m_data(other.m_data), m_storage(other.m_storage)
+	{
+		if (m_storage == VALUE_STORAGE)
+			add_ref(m_data.value->m_refs);
+	}
+
+	Json::Json(Json && other) JSON11_NOEXCEPT : m_data(other.m_data), m_storage(other.m_storage)
+	{
+		other.m_storage = NULL_STORAGE;
+	}
+
+	Json::~Json()
+	{
+		if (m_storage == VALUE_STORAGE && drop_ref(m_data.value->m_refs))
+			delete m_data.value;
+	}
+
+	template <class T, class... Args>
+	JsonValue * make_value(Args &&... args)
+	{
+		return new T(std::forward<Args>(args)...);
+	}
+
 	/* * * * * * * * * * * * * * * * * * * *
 	 * Constructors
 	 */
 
-	Json::Json() JSON11_NOEXCEPT                  : m_ptr(statics().null) {}
-	Json::Json(std::nullptr_t) JSON11_NOEXCEPT : m_ptr(statics().null) {}
-	Json::Json(double value) : m_ptr(std::make_shared<JsonDouble>(value)) {}
-	Json::Json(int value) : m_ptr(std::make_shared<JsonInt>(value)) {}
-	Json::Json(bool value) : m_ptr(value ? statics().t : statics().f) {}
-	Json::Json(const std::string &value) : m_ptr(std::make_shared<JsonString>(value)) {}
-	Json::Json(std::string &&value) : m_ptr(std::make_shared<JsonString>(move(value))) {}
-	Json::Json(const char * value) : m_ptr(std::make_shared<JsonString>(value)) {}
-	Json::Json(const Json::array &values) : m_ptr(std::make_shared<JsonArray>(values)) {}
-	Json::Json(Json::array &&values) : m_ptr(std::make_shared<JsonArray>(move(values))) {}
-	Json::Json(const Json::object &values) : m_ptr(std::make_shared<JsonObject>(values)) {}
-	Json::Json(Json::object &&values) : m_ptr(std::make_shared<JsonObject>(move(values))) {}
+	Json::Json() JSON11_NOEXCEPT : m_storage(NULL_STORAGE) { m_data.integer = 0; }
+	Json::Json(std::nullptr_t) JSON11_NOEXCEPT : m_storage(NULL_STORAGE) { m_data.integer = 0; }
+	Json::Json(double value) : m_storage(DOUBLE_STORAGE) { m_data.number = value; }
+	Json::Json(int value) : m_storage(INTEGER_STORAGE) { m_data.integer = value; }
+	Json::Json(long long value) : m_storage(INTEGER_STORAGE) { m_data.integer = value; }
+	Json::Json(bool value) : m_storage(BOOL_STORAGE) { m_data.integer = value; }
+	Json::Json(const std::string &value) : m_storage(VALUE_STORAGE) { m_data.value = make_value<JsonString>(value); }
+	Json::Json(std::string &&value) : m_storage(VALUE_STORAGE) { m_data.value = make_value<JsonString>(std::move(value)); }
+	Json::Json(const char * value) : m_storage(VALUE_STORAGE) { m_data.value = make_value<JsonString>(value); }
+	Json::Json(const Json::array &values) : m_storage(VALUE_STORAGE) { m_data.value = make_value<JsonArray>(values); }
+	Json::Json(Json::array &&values) : m_storage(VALUE_STORAGE) { m_data.value = make_value<JsonArray>(std::move(values)); }
+	Json::Json(const Json::object &values) : m_storage(VALUE_STORAGE) { m_data.value = make_value<JsonObject>(values); }
+	Json::Json(Json::object &&values) : m_storage(VALUE_STORAGE) { m_data.value = make_value<JsonObject>(std::move(values)); }
 
 	/* * * * * * * * * * * * * * * * * * * *
 	 * Accessors
 	 */
 
-	Json::Type Json::type()                           const { return m_ptr->type(); }
-	double Json::number_value()                       const { return m_ptr->number_value(); }
-	int Json::int_value()                             const { return m_ptr->int_value(); }
-	bool Json::bool_value()                           const { return m_ptr->bool_value(); }
-	const std::string & Json::string_value()               const { return m_ptr->string_value(); }
-	const std::vector<Json> & Json::array_items()          const { return m_ptr->array_items(); }
-	const std::map<std::string, Json> & Json::object_items()    const { return m_ptr->object_items(); }
-	const Json & Json::operator[] (size_t i)          const { return (*m_ptr)[i]; }
-	const Json & Json::operator[] (const std::string &key) const { return (*m_ptr)[key]; }
-
-	double                    JsonValue::number_value()              const { return 0; }
-	int                       JsonValue::int_value()                 const { return 0; }
-	bool                      JsonValue::bool_value()                const { return false; }
+	Json::Type Json::type() const
+	{
+		switch (m_storage)
+		{
+		case BOOL_STORAGE:
+			return BOOL;
+		case DOUBLE_STORAGE:
+		case INTEGER_STORAGE:
+			return NUMBER;
+		case VALUE_STORAGE:
+			return m_data.value->type();
+		default:
+			return NUL;
+		}
+	}
+	double Json::number_value() const
+	{
+		return m_storage == DOUBLE_STORAGE ? m_data.number
+			: m_storage == INTEGER_STORAGE ? double(m_data.integer) : 0;
+	}
+	int Json::int_value() const
+	{
+		return m_storage == DOUBLE_STORAGE ? int(m_data.number)
+			: m_storage == INTEGER_STORAGE ? int(m_data.integer) : 0;
+	}
+	bool Json::is_integer() const { return m_storage == INTEGER_STORAGE; }
+	long long Json::integer_value() const
+	{
+		return m_storage == DOUBLE_STORAGE ? (long long)m_data.number
+			: m_storage == INTEGER_STORAGE ? m_data.integer : 0;
+	}
+	bool Json::bool_value() const { return m_storage == BOOL_STORAGE && m_data.integer; }
+	const std::string & Json::string_value() const
+	{
+		return m_storage == VALUE_STORAGE ? m_data.value->string_value() : statics().empty_string;
+	}
+	const std::vector<Json> & Json::array_items() const
+	{
+		return m_storage == VALUE_STORAGE ? m_data.value->array_items() : statics().empty_vector;
+	}
+	const Json::object & Json::object_items() const
+	{
+		return m_storage == VALUE_STORAGE ? m_data.value->object_items() : statics().empty_map;
+	}
+	const Json & Json::operator[] (size_t i) const
+	{
+		return m_storage == VALUE_STORAGE ? (*m_data.value)[i] : static_null();
+	}
+	const Json & Json::operator[] (const std::string &key) const
+	{
+		return m_storage == VALUE_STORAGE ? (*m_data.value)[key] : static_null();
+	}
+	const Json & Json::operator[] (const Key &key) const
+	{
+		return m_storage == VALUE_STORAGE ? (*m_data.value)[key] : static_null();
+	}
+
 	const std::string &            JsonValue::string_value()              const { return statics().empty_string; }
 	const std::vector<Json> &      JsonValue::array_items()               const { return statics().empty_vector; }
-	const std::map<std::string, Json> & JsonValue::object_items()              const { return statics().empty_map; }
+	const Json::object & JsonValue::object_items()              const { return statics().empty_map; }
 	const Json &              JsonValue::operator[] (size_t)         const { return static_null(); }
 	const Json &              JsonValue::operator[] (const std::string &) const { return static_null(); }
+	const Json &              JsonValue::operator[] (const Key &)    const { return static_null(); }
 
 	const Json & JsonObject::operator[] (const std::string &key) const
 	{
 		auto iter = m_value.find(key);
 		return (iter == m_value.end()) ? static_null() : iter->second;
 	}
+	const Json & JsonObject::operator[] (const Key &key) const
+	{
+		auto iter = m_value.find(key);
+		return (iter == m_value.end()) ? static_null() : iter->second;
+	}
 	const Json & JsonArray::operator[] (size_t i) const
 	{
 		if (i >= m_value.size()) return static_null();
@@ -329,20 +397,76 @@ namespace json11
 	 * Comparison
 	 */
 
+	/* compare_integer_double(i, d)
+	 *
+	 * Orders integer i and double d exactly: -1, 0 or 1, 2 if d is NaN. Converting i to a
+	 * double instead rounds it beyond 2^53, so that 2^53 + 1 would equal 2^53.0 which
+	 * equals 2^53.
+	 */
+	static inline int compare_integer_double(long long i, double d)
+	{
+		if (d != d)
+			return 2;
+		if (d >= 9223372036854775808.0)
+			return -1;
+		if (d < -9223372036854775808.0)
+			return 1;
+		long long const whole = static_cast<long long>(d);
+		if (i != whole)
+			return i < whole ? -1 : 1;
+		double const fraction = d - static_cast<double>(whole);
+		return fraction > 0 ? -1 : fraction < 0 ? 1 : 0;
+	}
+
+	// numbers are compared exactly, integers beyond the 2^53 of a double included
 	bool Json::operator== (const Json &other) const
 	{
-		if (m_ptr->type() != other.m_ptr->type())
+		Type own_type = type();
+		if (own_type != other.type())
 			return false;
 
-		return m_ptr->equals(other.m_ptr.get());
+		switch (own_type)
+		{
+		case NUL:
+			return true;
+		case BOOL:
+			return bool_value() == other.bool_value();
+		case NUMBER:
+			if (is_integer() && other.is_integer())
+				return m_data.integer == other.m_data.integer;
+			if (is_integer())
+				return compare_integer_double(m_data.integer, other.number_value()) == 0;
+			if (other.is_integer())
+				return compare_integer_double(other.m_data.integer, number_value()) == 0;
+			return number_value() == other.number_value();
+		default:
+			return m_data.value->equals(other.m_data.value);
+		}
 	}
 
 	bool Json::operator< (const Json &other) const
 	{
-		if (m_ptr->type() != other.m_ptr->type())
-			return m_ptr->type() < other.m_ptr->type();
+		Type own_type = type();
+		if (own_type != other.type())
+			return own_type < other.type();
 
-		return m_ptr->less(other.m_ptr.get());
+		switch (own_type)
+		{
+		case NUL:
+			return false;
+		case BOOL:
+			return bool_value() < other.bool_value();
+		case NUMBER:
+			if (is_integer() && other.is_integer())
+				return m_data.integer < other.m_data.integer;
+			if (is_integer())
+				return compare_integer_double(m_data.integer, other.number_value()) < 0;
+			if (other.is_integer())
+				return compare_integer_double(other.m_data.integer, number_value()) == 1;
+			return number_value() < other.number_value();
+		default:
+			return m_data.value->less(other.m_data.value);
+		}
 	}
 
 	/* * * * * * * * * * * * * * * * * * * *
@@ -598,10 +722,13 @@ namespace json11
 				return fail("invalid " + esc(str[i]) + " in number");
 			}
 
-			if (str[i] != '.' && str[i] != 'e' && str[i] != 'E'
-				&& (i - start_pos) <= (size_t)std::numeric_limits<int>::digits10)
+			// Integers are kept exact, doubles only hold those outside the long long range
+			if (str[i] != '.' && str[i] != 'e' && str[i] != 'E')
 			{
-				return std::atoi(str.c_str() + start_pos);
+				errno = 0;
+				long long value = std::strtoll(str.c_str() + start_pos, nullptr, 10);
+				if (errno != ERANGE)
+					return value;
 			}
 
 			// Decimal part
@@ -689,10 +816,10 @@ namespace json11
 
 			if (ch == '{')
 			{
-				std::map<std::string, Json> data;
+				std::vector<Json::object::value_type> data;
 				ch = get_next_token();
 				if (ch == '}')
-					return data;
+					return Json::object();
 
 				while (1)
 				{
@@ -707,7 +834,7 @@ namespace json11
 					if (ch != ':')
 						return fail("expected ':' in object, got " + esc(ch));
 
-					data[std::move(key)] = parse_json(depth + 1);
+					data.push_back(Json::object::value_type(std::move(key), parse_json(depth + 1)));
 					if (failed)
 						return Json();
 
@@ -719,7 +846,7 @@ namespace json11
 
 					ch = get_next_token();
 				}
-				return data;
+				return Json::object(std::move(data), true);
 			}
 
 			if (ch == '[')
@@ -0,0 +1,408 @@
+/*
+ * Grisu.h
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _MSC_VER
+#define snprintf _snprintf
+#endif
+
+namespace GreenZone
+{
+
+	// Shortest round-trip formatting of doubles for compilers without std::to_chars:
+	// Grisu3 (F. Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+	// Integers", PLDI 2010) finds the shortest digits with 64-bit integer arithmetic and
+	// proves them right for all but about 0.5% of values, which fall back to the first of
+	// %.15e, %.16e and %.17e that reads back as the same value. The text is laid out like
+	// std::to_chars(first, last, value) lays it out, so both give the same output.
+	class Grisu
+	{
+	public:
+		enum { MaxDigits = 17 };
+
+		// Writes `value` into `buffer` (at least 32 bytes) without terminating it and
+		// returns the length.
+		static size_t format(double value, char * buffer)
+		{
+			if (value != value || value - value != 0)
+			{
+				// NaN and infinities
+				return snprintf(buffer, 32, "%g", value);
+			}
+			char * out = buffer;
+			if (std::signbit(value))
+			{
+				*out++ = '-';
+				value = -value;
+			}
+			if (value == 0)
+			{
+				*out++ = '0';
+				return out - buffer;
+			}
+			char digits[MaxDigits + 2];
+			int length, exponent;
+			if (!shortest(value, digits, length, exponent))
+			{
+				roundTrip(value, digits, length, exponent);
+			}
+			return out - buffer + layout(value, digits, length, exponent, out);
+		}
+
+		// Writes the shortest digits d1..dn of positive finite `value` such that
+		// d1..dn * 10^exponent reads back as `value`, the closest to it if there are
+		// several. Returns false if that can not be proven, leaving the outputs unspecified.
+		static bool shortest(double value, char * digits, int & length, int & exponent)
+		{
+			DiyFp w, minus, plus;
+			boundaries(value, w, minus, plus);
+			int powerExponent;
+			DiyFp const power = cachedPower(w.e, powerExponent);
+			int kappa;
+			if (!generateDigits(multiply(minus, power), multiply(w, power), multiply(plus, power), digits, length, kappa))
+			{
+				return false;
+			}
+			exponent = kappa - powerExponent;
+			return true;
+		}
+
+	protected:
+		// f * 2^e
+		struct DiyFp
+		{
+			unsigned long long f;
+			int e;
+		};
+		struct CachedPower
+		{
+			unsigned long long f;
+			short binaryExponent;
+			short decimalExponent;
+		};
+
+		// The digits w, m- and m+ are generated at: w * 10^k has its binary exponent in [Alpha, Gamma].
+		enum { Alpha = -60, Gamma = -32 };
+
+		static DiyFp normalize(DiyFp x)
+		{
+			while (!(x.f & 0xFFC0000000000000ull))
+			{
+				x.f <<= 10;
+				x.e -= 10;
+			}
+			while (!(x.f & 0x8000000000000000ull))
+			{
+				x.f <<= 1;
+				--x.e;
+			}
+			return x;
+		}
+
+		// The value, normalized, and the boundaries m- and m+ of the values that round to it,
+		// with the exponent of the value.
+		static void boundaries(double value, DiyFp & w, DiyFp & minus, DiyFp & plus)
+		{
+			unsigned long long bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			unsigned long long const fraction = bits & 0xFFFFFFFFFFFFFull;
+			int const biasedExponent = static_cast< int >(bits >> 52 & 0x7FF);
+			DiyFp v;
+			v.f = biasedExponent ? fraction | 0x10000000000000ull : fraction;
+			v.e = biasedExponent ? biasedExponent - 1075 : -1074;
+
+			DiyFp upper = { (v.f << 1) + 1, v.e - 1 };
+			plus = normalize(upper);
+			// the next lower double is closer when the value is a power of two
+			if (!fraction && biasedExponent > 1)
+			{
+				minus.f = (v.f << 2) - 1;
+				minus.e = v.e - 2;
+			}
+			else
+			{
+				minus.f = (v.f << 1) - 1;
+				minus.e = v.e - 1;
+			}
+			minus.f <<= minus.e - plus.e;
+			minus.e = plus.e;
+			w = normalize(v);
+		}
+
+		// The upper 64 bits of the product, rounded.
+		static DiyFp multiply(DiyFp x, DiyFp y)
+		{
+			unsigned long long const mask = 0xFFFFFFFFull;
+			unsigned long long const a = x.f >> 32, b = x.f & mask, c = y.f >> 32, d = y.f & mask;
+			unsigned long long const ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+			unsigned long long middle = (bd >> 32) + (ad & mask) + (bc & mask);
+			middle += 1ull << 31;
+			DiyFp result = { ac + (ad >> 32) + (bc >> 32) + (middle >> 32), x.e + y.e + 64 };
+			return result;
+		}
+
+		// 10^k normalized, rounded to 64 bits, for k = -348, -340, ..., 340.
+		static DiyFp cachedPower(int e, int & decimalExponent)
+		{
+			static CachedPower const powers[] =
+			{
+				{ 0xfa8fd5a0081c0288ull, -1220, -348 },
+				{ 0xbaaee17fa23ebf76ull, -1193, -340 },
+				{ 0x8b16fb203055ac76ull, -1166, -332 },
+				{ 0xcf42894a5dce35eaull, -1140, -324 },
+				{ 0x9a6bb0aa55653b2dull, -1113, -316 },
+				{ 0xe61acf033d1a45dfull, -1087, -308 },
+				{ 0xab70fe17c79ac6caull, -1060, -300 },
+				{ 0xff77b1fcbebcdc4full, -1034, -292 },
+				{ 0xbe5691ef416bd60cull, -1007, -284 },
+				{ 0x8dd01fad907ffc3cull, -980, -276 },
+				{ 0xd3515c2831559a83ull, -954, -268 },
+				{ 0x9d71ac8fada6c9b5ull, -927, -260 },
+				{ 0xea9c227723ee8bcbull, -901, -252 },
+				{ 0xaecc49914078536dull, -874, -244 },
+				{ 0x823c12795db6ce57ull, -847, -236 },
+				{ 0xc21094364dfb5637ull, -821, -228 },
+				{ 0x9096ea6f3848984full, -794, -220 },
+				{ 0xd77485cb25823ac7ull, -768, -212 },
+				{ 0xa086cfcd97bf97f4ull, -741, -204 },
+				{ 0xef340a98172aace5ull, -715, -196 },
+				{ 0xb23867fb2a35b28eull, -688, -188 },
+				{ 0x84c8d4dfd2c63f3bull, -661, -180 },
+				{ 0xc5dd44271ad3cdbaull, -635, -172 },
+				{ 0x936b9fcebb25c996ull, -608, -164 },
+				{ 0xdbac6c247d62a584ull, -582, -156 },
+				{ 0xa3ab66580d5fdaf6ull, -555, -148 },
+				{ 0xf3e2f893dec3f126ull, -529, -140 },
+				{ 0xb5b5ada8aaff80b8ull, -502, -132 },
+				{ 0x87625f056c7c4a8bull, -475, -124 },
+				{ 0xc9bcff6034c13053ull, -449, -116 },
+				{ 0x964e858c91ba2655ull, -422, -108 },
+				{ 0xdff9772470297ebdull, -396, -100 },
+				{ 0xa6dfbd9fb8e5b88full, -369, -92 },
+				{ 0xf8a95fcf88747d94ull, -343, -84 },
+				{ 0xb94470938fa89bcfull, -316, -76 },
+				{ 0x8a08f0f8bf0f156bull, -289, -68 },
+				{ 0xcdb02555653131b6ull, -263, -60 },
+				{ 0x993fe2c6d07b7facull, -236, -52 },
+				{ 0xe45c10c42a2b3b06ull, -210, -44 },
+				{ 0xaa242499697392d3ull, -183, -36 },
+				{ 0xfd87b5f28300ca0eull, -157, -28 },
+				{ 0xbce5086492111aebull, -130, -20 },
+				{ 0x8cbccc096f5088ccull, -103, -12 },
+				{ 0xd1b71758e219652cull, -77, -4 },
+				{ 0x9c40000000000000ull, -50, 4 },
+				{ 0xe8d4a51000000000ull, -24, 12 },
+				{ 0xad78ebc5ac620000ull, 3, 20 },
+				{ 0x813f3978f8940984ull, 30, 28 },
+				{ 0xc097ce7bc90715b3ull, 56, 36 },
+				{ 0x8f7e32ce7bea5c70ull, 83, 44 },
+				{ 0xd5d238a4abe98068ull, 109, 52 },
+				{ 0x9f4f2726179a2245ull, 136, 60 },
+				{ 0xed63a231d4c4fb27ull, 162, 68 },
+				{ 0xb0de65388cc8ada8ull, 189, 76 },
+				{ 0x83c7088e1aab65dbull, 216, 84 },
+				{ 0xc45d1df942711d9aull, 242, 92 },
+				{ 0x924d692ca61be758ull, 269, 100 },
+				{ 0xda01ee641a708deaull, 295, 108 },
+				{ 0xa26da3999aef774aull, 322, 116 },
+				{ 0xf209787bb47d6b85ull, 348, 124 },
+				{ 0xb454e4a179dd1877ull, 375, 132 },
+				{ 0x865b86925b9bc5c2ull, 402, 140 },
+				{ 0xc83553c5c8965d3dull, 428, 148 },
+				{ 0x952ab45cfa97a0b3ull, 455, 156 },
+				{ 0xde469fbd99a05fe3ull, 481, 164 },
+				{ 0xa59bc234db398c25ull, 508, 172 },
+				{ 0xf6c69a72a3989f5cull, 534, 180 },
+				{ 0xb7dcbf5354e9beceull, 561, 188 },
+				{ 0x88fcf317f22241e2ull, 588, 196 },
+				{ 0xcc20ce9bd35c78a5ull, 614, 204 },
+				{ 0x98165af37b2153dfull, 641, 212 },
+				{ 0xe2a0b5dc971f303aull, 667, 220 },
+				{ 0xa8d9d1535ce3b396ull, 694, 228 },
+				{ 0xfb9b7cd9a4a7443cull, 720, 236 },
+				{ 0xbb764c4ca7a44410ull, 747, 244 },
+				{ 0x8bab8eefb6409c1aull, 774, 252 },
+				{ 0xd01fef10a657842cull, 800, 260 },
+				{ 0x9b10a4e5e9913129ull, 827, 268 },
+				{ 0xe7109bfba19c0c9dull, 853, 276 },
+				{ 0xac2820d9623bf429ull, 880, 284 },
+				{ 0x80444b5e7aa7cf85ull, 907, 292 },
+				{ 0xbf21e44003acdd2dull, 933, 300 },
+				{ 0x8e679c2f5e44ff8full, 960, 308 },
+				{ 0xd433179d9c8cb841ull, 986, 316 },
+				{ 0x9e19db92b4e31ba9ull, 1013, 324 },
+				{ 0xeb96bf6ebadf77d9ull, 1039, 332 },
+				{ 0xaf87023b9bf0ee6bull, 1066, 340 },
+			};
+			int const k = static_cast< int >(std::ceil((Alpha - e - 1) * 0.30102999566398114));
+			CachedPower const & power = powers[(348 + k - 1) / 8 + 1];
+			decimalExponent = power.decimalExponent;
+			DiyFp result = { power.f, power.binaryExponent };
+			return result;
+		}
+
+		// Digit generation of Grisu3. `low`, `w` and `high` are scaled by the cached power
+		// and imprecise by up to one unit, so the digits are generated for the unsafe
+		// interval (low - 1, high + 1) and then checked to lie in the safe one.
+		static bool generateDigits(DiyFp low, DiyFp w, DiyFp high, char * digits, int & length, int & kappa)
+		{
+			unsigned long long unit = 1;
+			unsigned long long const tooHigh = high.f + unit;
+			unsigned long long unsafeInterval = tooHigh - (low.f - unit);
+			int const shift = -w.e;
+			unsigned long long const one = 1ull << shift;
+			unsigned integrals = static_cast< unsigned >(tooHigh >> shift);
+			unsigned long long fractionals = tooHigh & (one - 1);
+
+			static unsigned const powersOfTen[] =
+				{ 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+			kappa = 0;
+			while (kappa < 10 && integrals >= powersOfTen[kappa])
+			{
+				++kappa;
+			}
+			unsigned divisor = kappa ? powersOfTen[kappa - 1] : 1;
+			length = 0;
+			while (kappa > 0)
+			{
+				digits[length++] = static_cast< char >('0' + integrals / divisor);
+				integrals %= divisor;
+				--kappa;
+				unsigned long long const rest = (static_cast< unsigned long long >(integrals) << shift) + fractionals;
+				if (rest < unsafeInterval)
+				{
+					return roundWeed(digits, length, tooHigh - w.f, unsafeInterval, rest,
+						static_cast< unsigned long long >(divisor) << shift, unit);
+				}
+				divisor /= 10;
+			}
+			while (true)
+			{
+				fractionals *= 10;
+				unit *= 10;
+				unsafeInterval *= 10;
+				digits[length++] = static_cast< char >('0' + (fractionals >> shift));
+				fractionals &= one - 1;
+				--kappa;
+				if (fractionals < unsafeInterval)
+				{
+					return roundWeed(digits, length, (tooHigh - w.f) * unit, unsafeInterval, fractionals, one, unit);
+				}
+			}
+		}
+
+		// Moves the last digit towards w while that brings the digits closer to it, then
+		// checks that they are the closest ones inside the safe interval.
+		static bool roundWeed(char * digits, int length, unsigned long long distanceTooHighW,
+			unsigned long long unsafeInterval, unsigned long long rest, unsigned long long tenKappa,
+			unsigned long long unit)
+		{
+			unsigned long long const smallDistance = distanceTooHighW - unit;
+			unsigned long long const bigDistance = distanceTooHighW + unit;
+			while (rest < smallDistance && unsafeInterval - rest >= tenKappa &&
+				(rest + tenKappa < smallDistance || smallDistance - rest >= rest + tenKappa - smallDistance))
+			{
+				--digits[length - 1];
+				rest += tenKappa;
+			}
+			if (rest < bigDistance && unsafeInterval - rest >= tenKappa &&
+				(rest + tenKappa < bigDistance || bigDistance - rest > rest + tenKappa - bigDistance))
+			{
+				return false;
+			}
+			return 2 * unit <= rest && rest <= unsafeInterval - 4 * unit;
+		}
+
+		// The digits of the first of 15, 16 and 17 significant digits that reads back as
+		// `value`. With 15 or fewer digits the shortest form is a prefix of the 15 ones.
+		static void roundTrip(double value, char * digits, int & length, int & exponent)
+		{
+			char text[32];
+			for (int precision = 15; precision <= MaxDigits; ++precision)
+			{
+				snprintf(text, sizeof(text), "%.*e", precision - 1, value);
+				if (std::strtod(text, nullptr) == value)
+				{
+					break;
+				}
+			}
+			char const * c = text;
+			length = 0;
+			for (; *c != 'e'; ++c)
+			{
+				if (*c != '.')
+				{
+					digits[length++] = *c;
+				}
+			}
+			while (length > 1 && digits[length - 1] == '0')
+			{
+				--length;
+			}
+			exponent = std::atoi(c + 1) - (length - 1);
+		}
+
+		// Lays out d1..dn * 10^exponent, the digits of `value`, in fixed or scientific
+		// notation, whichever is shorter (fixed on a tie), as std::to_chars does.
+		static size_t layout(double value, char const * digits, int length, int exponent, char * buffer)
+		{
+			int const point = length + exponent;
+			int const scientificExponent = point - 1;
+			int const absoluteExponent = scientificExponent < 0 ? -scientificExponent : scientificExponent;
+			int const scientificLength = length + (length > 1) + 2 + (absoluteExponent >= 100 ? 3 : 2);
+			int const fixedLength = exponent >= 0 ? point : point > 0 ? length + 1 : 2 - point + length;
+			char * out = buffer;
+			if (fixedLength <= scientificLength)
+			{
+				if (exponent > 0)
+				{
+					// an integer above 2^53, written with all its digits rather than zeros
+					return snprintf(out, 32, "%.0f", value);
+				}
+				if (!exponent)
+				{
+					std::memcpy(out, digits, length);
+				}
+				else if (point > 0)
+				{
+					std::memcpy(out, digits, point);
+					out[point] = '.';
+					std::memcpy(out + point + 1, digits + point, length - point);
+				}
+				else
+				{
+					out[0] = '0';
+					out[1] = '.';
+					std::memset(out + 2, '0', -point);
+					std::memcpy(out + 2 - point, digits, length);
+				}
+				return fixedLength;
+			}
+			*out++ = digits[0];
+			if (length > 1)
+			{
+				*out++ = '.';
+				std::memcpy(out, digits + 1, length - 1);
+				out += length - 1;
+			}
+			*out++ = 'e';
+			*out++ = scientificExponent < 0 ? '-' : '+';
+			if (absoluteExponent >= 100)
+			{
+				*out++ = static_cast< char >('0' + absoluteExponent / 100);
+			}
+			*out++ = static_cast< char >('0' + absoluteExponent / 10 % 10);
+			*out++ = static_cast< char >('0' + absoluteExponent % 10);
+			return out - buffer;
+		}
+	};
+
+} /* namespace RedZone */
@@ -0,0 +1,138 @@
+/*
+ * BufferPool.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace GreenZone
+{
+
+	// Per-thread free list of output strings. Released buffers keep their capacity, so
+	// once warmed up acquire() does not allocate. A thread keeps at most MaxBuffers
+	// buffers of MaxBytes in all.
+	class BufferPool
+	{
+	public:
+		// An empty string, with the capacity it had when released if it comes from the pool.
+		static std::string acquire()
+		{
+			ThreadBuffers & pool = threadBuffers();
+			if (pool.buffers.empty())
+			{
+				return std::string();
+			}
+			std::string buffer;
+			buffer.swap(pool.buffers.back());
+			pool.buffers.pop_back();
+			pool.bytes -= buffer.capacity();
+			return buffer;
+		}
+
+		// Returns a buffer to the pool of the calling thread. `sizeHint` is the size expected
+		// of the outputs rendered into it (Template::outputSizeHint()), zero if unknown: a
+		// buffer grown past twice that size by an unusually large output is freed, as are
+		// buffers that do not fit the pool.
+		static void release(std::string & buffer, size_t sizeHint = 0)
+		{
+			ThreadBuffers & pool = threadBuffers();
+			size_t const capacity = buffer.capacity();
+			if (pool.buffers.size() >= MaxBuffers || capacity > MaxBytes - pool.bytes ||
+				(sizeHint && capacity / 2 > sizeHint))
+			{
+				std::string().swap(buffer);
+				return;
+			}
+			buffer.clear();
+			pool.buffers.push_back(std::string());
+			pool.buffers.back().swap(buffer);
+			pool.bytes += capacity;
+		}
+
+		enum { MaxBuffers = 8 };
+		enum { MaxBytes = 4 << 20 };
+
+	protected:
+		struct ThreadBuffers
+		{
+			ThreadBuffers()
+				: bytes(0)
+			{}
+
+			std::vector< std::string > buffers;
+			size_t bytes;  // capacity of the pooled buffers
+		};
+
+		static ThreadBuffers & threadBuffers()
+		{
+			static thread_local ThreadBuffers s_buffers;
+			return s_buffers;
+		}
+	};
+
+
+	// Output string borrowed from the BufferPool, given back when the handle is destroyed.
+	class PooledString
+	{
+	public:
+		// `sizeHint`: see BufferPool::release().
+		explicit PooledString(size_t sizeHint = 0)
+			: m_string(BufferPool::acquire()), m_sizeHint(sizeHint)
+		{}
+		PooledString(PooledString && other)
+			: m_sizeHint(other.m_sizeHint)
+		{
+			m_string.swap(other.m_string);
+		}
+		PooledString & operator=(PooledString && other)
+		{
+			m_string.swap(other.m_string);
+			std::swap(m_sizeHint, other.m_sizeHint);
+			return *this;
+		}
+
+		std::string & str()
+		{
+			return m_string;
+		}
+		std::string const & str() const
+		{
+			return m_string;
+		}
+		operator std::string const &() const
+		{
+			return m_string;
+		}
+		char const * data() const
+		{
+			return m_string.data();
+		}
+		size_t size() const
+		{
+			return m_string.size();
+		}
+
+		~PooledString()
+		{
+			if (m_string.capacity())
+			{
+				BufferPool::release(m_string, m_sizeHint);
+			}
+		}
+
+	private:
+		PooledString(PooledString const &);
+		PooledString & operator=(PooledString const &);
+
+	protected:
+		std::string m_string;
+		size_t m_sizeHint;
+	};
+
+} /* namespace RedZone */
@@ -0,0 +1,142 @@
+/*
+ * BufferedWriter.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <IO/Writer.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+
+namespace GreenZone
+{
+
+	// Allocates blocks aligned to a memory page.
+	template< class T >
+	class PageAllocator
+	{
+	public:
+		typedef T value_type;
+		typedef T * pointer;
+		typedef T const * const_pointer;
+		typedef T & reference;
+		typedef T const & const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		template< class U >
+		struct rebind
+		{
+			typedef PageAllocator< U > other;
+		};
+
+		enum { Alignment = 4096 };
+
+		PageAllocator(){}
+		template< class U >
+		PageAllocator(PageAllocator< U > const &){}
+
+		T * allocate(size_t count)
+		{
+			void * memory = nullptr;
+#ifdef _MSC_VER
+			memory = _aligned_malloc(count * sizeof(T), Alignment);
+#else
+			if (posix_memalign(&memory, Alignment, count * sizeof(T)))
+			{
+				memory = nullptr;
+			}
+#endif
+			if (!memory)
+			{
+				throw std::bad_alloc();
+			}
+			return static_cast< T * >(memory);
+		}
+		void deallocate(T * memory, size_t)
+		{
+#ifdef _MSC_VER
+			_aligned_free(memory);
+#else
+			free(memory);
+#endif
+		}
+
+		template< class U >
+		bool operator==(PageAllocator< U > const &) const { return true; }
+		template< class U >
+		bool operator!=(PageAllocator< U > const &) const { return false; }
+	};
+
+	// Collects output in one contiguous buffer and hands it to writeBuffer() in big
+	// chunks. The buffer is page aligned. Writes larger than the buffer bypass it.
+	// Subclasses should flush() in their destructor, writeBuffer() can not be called
+	// from this one.
+	class BufferedWriter : public Writer
+	{
+	public:
+		using Writer::write;
+		virtual void write(char const * data, size_t size)
+		{
+			if (size > m_buffer.size() - m_used)
+			{
+				flushBuffer();
+				if (size >= m_buffer.size())
+				{
+					writeBuffer(data, size);
+					return;
+				}
+			}
+			std::memcpy(m_buffer.data() + m_used, data, size);
+			m_used += size;
+		}
+		virtual void write(char c)
+		{
+			if (m_used == m_buffer.size())
+			{
+				flushBuffer();
+			}
+			m_buffer[m_used++] = c;
+		}
+		virtual void flush()
+		{
+			flushBuffer();
+		}
+
+		virtual ~BufferedWriter(){}
+
+	protected:
+		explicit BufferedWriter(size_t capacity = 64 * 1024)
+			: m_buffer(capacity ? capacity : 1), m_used(0)
+		{}
+
+		// Receives the buffered output.
+		virtual void writeBuffer(char const * data, size_t size) = 0;
+
+		void flushBuffer()
+		{
+			if (m_used)
+			{
+				size_t used = m_used;
+				m_used = 0;
+				writeBuffer(&m_buffer[0], used);
+			}
+		}
+
+	protected:
+		typedef std::vector< char, PageAllocator< char > > Buffer;
+
+		Buffer m_buffer;
+		size_t m_used;
+	};
+
+} /* namespace RedZone */
@@ -0,0 +1,131 @@
+/*
+ * ChunkedWriter.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <IO/BufferedWriter.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+
+namespace GreenZone
+{
+
+	// Streams output to `sink` in chunks of exactly `chunkSize` bytes; flush() and flush
+	// points ({% flush %}, the end of <head>) emit a shorter chunk with what is pending.
+	// The sink runs on the rendering thread, so a sink that blocks (e.g. on a full
+	// ChunkChannel) pauses rendering until the consumer catches up.
+	class ChunkedWriter : public BufferedWriter
+	{
+	public:
+		typedef std::function< void(char const * data, size_t size) > Sink;
+
+		ChunkedWriter(Sink sink, size_t chunkSize = 16 * 1024)
+			: BufferedWriter(chunkSize), m_sink(sink)
+		{}
+
+		using BufferedWriter::write;
+		virtual void write(char const * data, size_t size)
+		{
+			while (size)
+			{
+				size_t part = std::min(size, m_buffer.size() - m_used);
+				std::memcpy(&m_buffer[m_used], data, part);
+				m_used += part;
+				data += part;
+				size -= part;
+				if (m_used == m_buffer.size())
+				{
+					flushBuffer();
+				}
+			}
+		}
+		virtual void flushPoint()
+		{
+			flushBuffer();
+		}
+
+		// Pending output is not emitted on destruction, call flush() at the end of the render.
+		virtual ~ChunkedWriter(){}
+
+	protected:
+		virtual void writeBuffer(char const * data, size_t size)
+		{
+			m_sink(data, size);
+		}
+
+	protected:
+		Sink m_sink;
+	};
+
+
+	// Bounded queue of chunks between a rendering thread and a consumer. push() blocks
+	// while `capacity` chunks are waiting, pop() blocks until a chunk arrives or the
+	// channel is closed.
+	class ChunkChannel
+	{
+	public:
+		explicit ChunkChannel(size_t capacity = 4)
+			: m_capacity(capacity ? capacity : 1), m_closed(false)
+		{}
+
+		void push(char const * data, size_t size)
+		{
+			std::unique_lock< std::mutex > lock(m_mutex);
+			m_changed.wait(lock, [this]() { return m_chunks.size() < m_capacity || m_closed; });
+			if (m_closed)
+			{
+				return;
+			}
+			m_chunks.push_back(std::string(data, size));
+			m_changed.notify_all();
+		}
+
+		// False once the channel is closed and drained.
+		bool pop(std::string & chunk)
+		{
+			std::unique_lock< std::mutex > lock(m_mutex);
+			m_changed.wait(lock, [this]() { return m_chunks.size() || m_closed; });
+			if (m_chunks.empty())
+			{
+				return false;
+			}
+			chunk.swap(m_chunks.front());
+			m_chunks.pop_front();
+			m_changed.notify_all();
+			return true;
+		}
+
+		// Ends the stream. Chunks pushed afterwards are dropped.
+		void close()
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			m_closed = true;
+			m_changed.notify_all();
+		}
+
+		ChunkedWriter::Sink sink()
+		{
+			return std::bind(&ChunkChannel::push, this, std::placeholders::_1, std::placeholders::_2);
+		}
+
+		virtual ~ChunkChannel(){}
+
+	protected:
+		size_t m_capacity;
+		bool m_closed;
+		std::deque< std::string > m_chunks;
+		std::mutex m_mutex;
+		std::condition_variable m_changed;
+	};
+
+} /* namespace RedZone */
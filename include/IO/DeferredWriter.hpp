@@ -0,0 +1,221 @@
+/*
+ * DeferredWriter.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Context/Context.hpp>
+#include <Exception.hpp>
+#include <IO/StringWriter.hpp>
+#include <IO/Writer.hpp>
+#include <ThreadPool.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace GreenZone
+{
+
+	// Writer for templates with {% defer %} blocks. Deferred blocks are rendered on a
+	// thread pool (with a snapshot of their context) while the rest of the page goes on.
+	// Call finish() after rendering:
+	//   Append     - the page streams to the target with an empty
+	//                <template data-gz-placeholder="N"></template> in place of each block,
+	//                finish() then appends the blocks as they complete, each wrapped in
+	//                <template data-gz-defer="N">...</template> for the client to move.
+	//   Substitute - the page is buffered and finish() writes it to the target in one
+	//                piece, with the blocks in place.
+	class DeferredWriter : public Writer
+	{
+	public:
+		enum Mode
+		{
+			Append,
+			Substitute
+		};
+		typedef std::function< void(Writer *, Context *) > Block;
+
+		DeferredWriter(Writer * target, Mode mode = Append, ThreadPool * pool = nullptr)
+			: m_target(target), m_mode(mode), m_pool(pool ? *pool : ThreadPool::shared()), m_tasks(m_pool)
+		{
+#ifdef JSON11_NONATOMIC_REFCOUNT
+			throw Exception("Deferred blocks need atomic reference counts, the build defines JSON11_NONATOMIC_REFCOUNT");
+#endif
+		}
+
+		using Writer::write;
+		virtual void write(char const * data, size_t size)
+		{
+			if (m_mode == Append)
+				m_target->write(data, size);
+			else
+				m_buffer.append(data, size);
+		}
+		virtual void writeStatic(char const * data, size_t size)
+		{
+			if (m_mode == Append)
+				m_target->writeStatic(data, size);
+			else
+				m_buffer.append(data, size);
+		}
+		virtual void writeStatic(StaticText const & text)
+		{
+			if (m_mode == Append)
+				m_target->writeStatic(text);
+			else
+				m_buffer.append(text.data(), text.size());
+		}
+		virtual void flushPoint()
+		{
+			if (m_mode == Append)
+				m_target->flushPoint();
+		}
+		virtual void reserve(size_t size)
+		{
+			if (m_mode == Append)
+				m_target->reserve(size);
+			else if (m_buffer.capacity() < m_buffer.size() + size)
+				m_buffer.reserve(m_buffer.size() + size);
+		}
+		virtual void flush()
+		{
+			if (m_mode == Append)
+				m_target->flush();
+		}
+		// {% defer %} blocks find this writer among the ones they render to
+		virtual bool acceptsReplay() const
+		{
+			return false;
+		}
+
+		// Schedules `block` and leaves its placeholder in the output.
+		void defer(Block block, Context * context)
+		{
+			size_t id = m_deferred.size();
+			m_deferred.emplace_back(new Deferred());
+			Deferred * deferred = m_deferred.back().get();
+			deferred->offset = m_buffer.size();
+			if (m_mode == Append)
+			{
+				std::string const placeholder = "<template data-gz-placeholder=\"" + std::to_string(id) + "\"></template>";
+				m_target->write(placeholder);
+			}
+			// loop contexts change after this returns, the block gets its own copy
+			std::shared_ptr< Context > snapshot(new Context(*context));
+			m_tasks.run([this, id, deferred, block, snapshot]()
+			{
+				try
+				{
+					StringWriter writer(deferred->output);
+					block(&writer, snapshot.get());
+				}
+				catch (...)
+				{
+					deferred->error = std::current_exception();
+				}
+				std::lock_guard< std::mutex > lock(m_mutex);
+				m_completed.push_back(id);
+				m_progress.notify_all();
+			});
+		}
+
+		// Waits for the deferred blocks and writes them to the target. Rethrows the first
+		// exception of a block.
+		void finish()
+		{
+			for (size_t emitted = 0; emitted < m_deferred.size(); ++emitted)
+			{
+				size_t id = nextCompleted();
+				Deferred & deferred = *m_deferred[id];
+				if (deferred.error)
+				{
+					std::rethrow_exception(deferred.error);
+				}
+				if (m_mode == Append)
+				{
+					m_target->write("<template data-gz-defer=\"" + std::to_string(id) + "\">");
+					m_target->write(deferred.output);
+					m_target->write("</template>", 11);
+					m_target->flushPoint();
+				}
+			}
+			m_tasks.wait();
+			if (m_mode == Substitute)
+			{
+				size_t offset = 0;
+				for (auto const & deferred : m_deferred)
+				{
+					m_target->write(m_buffer.data() + offset, deferred->offset - offset);
+					m_target->write(deferred->output);
+					offset = deferred->offset;
+				}
+				m_target->write(m_buffer.data() + offset, m_buffer.size() - offset);
+			}
+			m_deferred.clear();
+			m_completed.clear();
+			m_buffer.clear();
+		}
+
+		size_t deferredCount() const
+		{
+			return m_deferred.size();
+		}
+
+		virtual ~DeferredWriter(){}
+
+	protected:
+		struct Deferred
+		{
+			Deferred()
+				: offset(0)
+			{}
+
+			size_t offset;
+			std::string output;
+			std::exception_ptr error;
+		};
+
+		// Runs pending blocks while waiting, the caller may be one of the pool's threads.
+		size_t nextCompleted()
+		{
+			std::unique_lock< std::mutex > lock(m_mutex);
+			while (m_completed.empty())
+			{
+				lock.unlock();
+				if (!m_tasks.runPendingTask())
+				{
+					lock.lock();
+					m_progress.wait_for(lock, std::chrono::milliseconds(1));
+					continue;
+				}
+				lock.lock();
+			}
+			size_t id = m_completed.front();
+			m_completed.pop_front();
+			return id;
+		}
+
+	protected:
+		Writer * m_target;
+		Mode m_mode;
+		ThreadPool & m_pool;
+		std::string m_buffer;
+		std::vector< std::unique_ptr< Deferred > > m_deferred;
+		std::deque< size_t > m_completed;
+		std::mutex m_mutex;
+		std::condition_variable m_progress;
+		// last, so pending blocks are waited for before anything they use is destroyed
+		TaskGroup m_tasks;
+	};
+
+} /* namespace RedZone */
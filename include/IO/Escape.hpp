@@ -0,0 +1,231 @@
+/*
+ * Escape.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Exception.hpp>
+#include <IO/StringWriter.hpp>
+#include <IO/Writer.hpp>
+
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GREENZONE_ESCAPE_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace GreenZone
+{
+
+	enum class EscapeMode
+	{
+		Inherit,    // not set, written as is unless an enclosing autoescape sets it
+		None,
+		Html,       // & < > " '
+		Attribute,  // Html plus ` and =
+		Js,         // inside a JS string literal: quotes, \, <, >, &, control characters, U+2028/9
+		Url         // percent-encodes everything but unreserved characters (RFC 3986)
+	};
+
+	inline EscapeMode escapeModeByName(std::string const & name)
+	{
+		if (name == "none" || name == "false" || name == "off")
+			return EscapeMode::None;
+		if (name == "html" || name == "true" || name == "on")
+			return EscapeMode::Html;
+		if (name == "attribute" || name == "attr")
+			return EscapeMode::Attribute;
+		if (name == "js")
+			return EscapeMode::Js;
+		if (name == "url")
+			return EscapeMode::Url;
+		throw Exception("Unknown escape mode " + name);
+	}
+
+	class Escaper
+	{
+	public:
+		// Writes `data` escaped for `mode`: clean runs go to the writer in one piece and
+		// only special characters are handled one by one.
+		static void write(Writer * stream, EscapeMode mode, char const * data, size_t size)
+		{
+			if (mode == EscapeMode::Inherit || mode == EscapeMode::None)
+			{
+				stream->write(data, size);
+				return;
+			}
+			size_t run = 0, i = 0;
+			while (true)
+			{
+				i = findSpecial(mode, data, i, size);
+				if (i == size)
+				{
+					break;
+				}
+				stream->write(data + run, i - run);
+				i += writeReplacement(stream, mode, data + i, size - i);
+				run = i;
+			}
+			stream->write(data + run, size - run);
+		}
+
+		static std::string escape(EscapeMode mode, std::string const & text)
+		{
+			std::string result;
+			StringWriter writer(result);
+			write(&writer, mode, text.data(), text.size());
+			return result;
+		}
+
+	protected:
+		static bool isSpecial(EscapeMode mode, unsigned char c)
+		{
+			switch (mode)
+			{
+			case EscapeMode::Html:
+				return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'';
+			case EscapeMode::Attribute:
+				return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'' || c == '`' || c == '=';
+			case EscapeMode::Js:
+				return c < 0x20 || c == '\\' || c == '\'' || c == '"' || c == '<' || c == '>' || c == '&' || c == 0xE2;
+			case EscapeMode::Url:
+				return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+					c == '-' || c == '.' || c == '_' || c == '~');
+			default:
+				return false;
+			}
+		}
+
+		static size_t findSpecial(EscapeMode mode, char const * data, size_t i, size_t size)
+		{
+#ifdef GREENZONE_ESCAPE_SSE2
+			for (; i + 16 <= size; i += 16)
+			{
+				unsigned mask = specialMask(mode, _mm_loadu_si128(reinterpret_cast< __m128i const * >(data + i)));
+				if (mask)
+				{
+					return i + firstBit(mask);
+				}
+			}
+#endif
+			while (i < size && !isSpecial(mode, static_cast< unsigned char >(data[i])))
+			{
+				++i;
+			}
+			return i;
+		}
+
+#ifdef GREENZONE_ESCAPE_SSE2
+		static __m128i equal(__m128i chunk, char c)
+		{
+			return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c));
+		}
+		// bytes >= 0x80 are negative, so they are never in an ASCII range
+		static __m128i inRange(__m128i chunk, char low, char high)
+		{
+			return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(low - 1)),
+				_mm_cmplt_epi8(chunk, _mm_set1_epi8(high + 1)));
+		}
+
+		static unsigned specialMask(EscapeMode mode, __m128i chunk)
+		{
+			__m128i special;
+			switch (mode)
+			{
+			case EscapeMode::Html:
+			case EscapeMode::Attribute:
+				special = _mm_or_si128(_mm_or_si128(equal(chunk, '&'), equal(chunk, '<')),
+					_mm_or_si128(_mm_or_si128(equal(chunk, '>'), equal(chunk, '"')), equal(chunk, '\'')));
+				if (mode == EscapeMode::Attribute)
+				{
+					special = _mm_or_si128(special, _mm_or_si128(equal(chunk, '`'), equal(chunk, '=')));
+				}
+				break;
+			case EscapeMode::Js:
+				special = _mm_or_si128(
+					_mm_or_si128(_mm_or_si128(equal(chunk, '\\'), equal(chunk, '\'')), _mm_or_si128(equal(chunk, '"'), equal(chunk, '<'))),
+					_mm_or_si128(_mm_or_si128(equal(chunk, '>'), equal(chunk, '&')), equal(chunk, '\xE2')));
+				// unsigned c <= 0x1F
+				special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(chunk, _mm_set1_epi8(0x1F)), chunk));
+				break;
+			case EscapeMode::Url:
+				special = _mm_or_si128(_mm_or_si128(inRange(chunk, 'a', 'z'), inRange(chunk, 'A', 'Z')),
+					_mm_or_si128(_mm_or_si128(inRange(chunk, '0', '9'), equal(chunk, '-')),
+					_mm_or_si128(_mm_or_si128(equal(chunk, '.'), equal(chunk, '_')), equal(chunk, '~'))));
+				return ~unsigned(_mm_movemask_epi8(special)) & 0xFFFF;
+			default:
+				return 0;
+			}
+			return unsigned(_mm_movemask_epi8(special));
+		}
+
+		static unsigned firstBit(unsigned mask)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return __builtin_ctz(mask);
+#endif
+		}
+#endif
+
+		// Writes the escaped form of the special character at `data`, returns the number of
+		// bytes it replaces.
+		static size_t writeReplacement(Writer * stream, EscapeMode mode, char const * data, size_t size)
+		{
+			static char const hex[] = "0123456789ABCDEF";
+			unsigned char c = static_cast< unsigned char >(*data);
+			if (mode == EscapeMode::Url)
+			{
+				char encoded[3] = { '%', hex[c >> 4], hex[c & 0xF] };
+				stream->write(encoded, 3);
+				return 1;
+			}
+			if (mode == EscapeMode::Js)
+			{
+				switch (c)
+				{
+				case '\\': stream->write("\\\\", 2); return 1;
+				case '\'': stream->write("\\'", 2); return 1;
+				case '"': stream->write("\\\"", 2); return 1;
+				case '\n': stream->write("\\n", 2); return 1;
+				case '\r': stream->write("\\r", 2); return 1;
+				case '\t': stream->write("\\t", 2); return 1;
+				case 0xE2:
+					// U+2028 and U+2029 end a line in JS source
+					if (size >= 3 && static_cast< unsigned char >(data[1]) == 0x80 &&
+						(static_cast< unsigned char >(data[2]) == 0xA8 || static_cast< unsigned char >(data[2]) == 0xA9))
+					{
+						stream->write(static_cast< unsigned char >(data[2]) == 0xA8 ? "\\u2028" : "\\u2029", 6);
+						return 3;
+					}
+					stream->write(data, 1);
+					return 1;
+				}
+				char encoded[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+				stream->write(encoded, 6);
+				return 1;
+			}
+			switch (c)
+			{
+			case '&': stream->write("&amp;", 5); break;
+			case '<': stream->write("&lt;", 4); break;
+			case '>': stream->write("&gt;", 4); break;
+			case '"': stream->write("&quot;", 6); break;
+			case '\'': stream->write("&#39;", 5); break;
+			case '`': stream->write("&#96;", 5); break;
+			case '=': stream->write("&#61;", 5); break;
+			}
+			return 1;
+		}
+	};
+
+} /* namespace RedZone */
@@ -0,0 +1,242 @@
+/*
+ * FileWriter.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Exception.hpp>
+#include <IO/BufferedWriter.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+
+namespace GreenZone
+{
+
+	// Writes to a file through its descriptor, in chunks of `bufferSize` bytes. With
+	// `asyncFlush` full buffers are written by a background thread while rendering
+	// continues into a second buffer, so rendering only waits for the disk when it gets
+	// a whole buffer ahead of it. Write errors of the background thread are thrown by the
+	// next write(), flush() or close().
+	class FileWriter : public BufferedWriter
+	{
+	public:
+		FileWriter(std::string const & fileName, size_t bufferSize = 1 << 20, bool asyncFlush = false)
+			: BufferedWriter(bufferSize), m_fileName(fileName), m_fd(openFile(fileName)),
+			m_async(asyncFlush), m_pendingData(nullptr), m_pendingSize(0), m_stop(false)
+		{
+			if (m_async)
+			{
+				m_spare.resize(m_buffer.size());
+				m_thread = std::thread(&FileWriter::flushLoop, this);
+			}
+		}
+
+		// Hands buffered output to the OS and waits for background writes.
+		virtual void flush()
+		{
+			flushBuffer();
+			waitPending();
+		}
+
+		// Flushes and closes the file.
+		void close()
+		{
+			if (m_fd < 0)
+			{
+				return;
+			}
+			std::exception_ptr error;
+			try
+			{
+				flush();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			stopThread();
+			closeFile(m_fd);
+			m_fd = -1;
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+		}
+
+		virtual ~FileWriter()
+		{
+			try
+			{
+				close();
+			}
+			catch (...)
+			{
+			}
+		}
+
+	protected:
+		virtual void writeBuffer(char const * data, size_t size)
+		{
+			if (m_fd < 0)
+			{
+				throw IOError("Write to closed file " + m_fileName);
+			}
+			waitPending();
+			if (!m_async || data != m_buffer.data())
+			{
+				writeAll(data, size);
+				return;
+			}
+			// the full buffer goes to the background thread, rendering continues in the spare
+			m_buffer.swap(m_spare);
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				m_pendingData = data;
+				m_pendingSize = size;
+			}
+			m_wake.notify_all();
+		}
+
+		void waitPending()
+		{
+			if (!m_async)
+			{
+				return;
+			}
+			std::unique_lock< std::mutex > lock(m_mutex);
+			m_wake.wait(lock, [this]() { return !m_pendingData; });
+			if (m_error)
+			{
+				std::exception_ptr error = m_error;
+				m_error = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+
+		void flushLoop()
+		{
+			std::unique_lock< std::mutex > lock(m_mutex);
+			while (true)
+			{
+				m_wake.wait(lock, [this]() { return m_stop || m_pendingData; });
+				if (!m_pendingData)
+				{
+					return;
+				}
+				char const * data = m_pendingData;
+				size_t size = m_pendingSize;
+				lock.unlock();
+				std::exception_ptr error;
+				try
+				{
+					writeAll(data, size);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				lock.lock();
+				m_pendingData = nullptr;
+				if (error && !m_error)
+				{
+					m_error = error;
+				}
+				m_wake.notify_all();
+			}
+		}
+
+		void stopThread()
+		{
+			if (!m_thread.joinable())
+			{
+				return;
+			}
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			m_thread.join();
+		}
+
+		void writeAll(char const * data, size_t size) const
+		{
+			while (size)
+			{
+#ifdef _WIN32
+				int written = ::_write(m_fd, data, static_cast< unsigned >(std::min< size_t >(size, 1 << 30)));
+#else
+				ssize_t written = ::write(m_fd, data, size);
+#endif
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					throw IOError("Can not write " + m_fileName + " file: " + std::strerror(errno));
+				}
+				data += written;
+				size -= written;
+			}
+		}
+
+		static int openFile(std::string const & fileName)
+		{
+#ifdef _WIN32
+			int fd = ::_open(fileName.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+			int fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+			if (fd < 0)
+			{
+				throw IOError("Can not open " + fileName + " file.");
+			}
+			return fd;
+		}
+		static void closeFile(int fd)
+		{
+#ifdef _WIN32
+			::_close(fd);
+#else
+			::close(fd);
+#endif
+		}
+
+	private:
+		FileWriter(FileWriter const &);
+		FileWriter & operator=(FileWriter const &);
+
+	protected:
+		std::string m_fileName;
+		int m_fd;
+		bool m_async;
+		Buffer m_spare;
+		char const * m_pendingData;
+		size_t m_pendingSize;
+		bool m_stop;
+		std::exception_ptr m_error;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::thread m_thread;
+	};
+
+} /* namespace RedZone */
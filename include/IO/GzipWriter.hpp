@@ -0,0 +1,228 @@
+/*
+ * GzipWriter.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Exception.hpp>
+#include <IO/StaticText.hpp>
+#include <IO/Writer.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+
+namespace GreenZone
+{
+
+	// Compresses the output as it is rendered and passes it to `target` (requires
+	// zlib). Static template text of at least `minPrecompressed` bytes is deflated
+	// only once, on its first use, and kept with the template: the live stream is then
+	// brought to a block boundary with a full flush (which also resets its history) and
+	// the precompressed blocks are copied in. Call finish() after rendering.
+	class GzipWriter : public Writer
+	{
+	public:
+		enum Format
+		{
+			Gzip,    // RFC 1952
+			Deflate  // RFC 1950, the HTTP "deflate" content coding
+		};
+
+		GzipWriter(Writer * target, Format format = Gzip, int level = Z_DEFAULT_COMPRESSION,
+			size_t minPrecompressed = 1024)
+			: m_target(target), m_format(format), m_level(level), m_minPrecompressed(minPrecompressed),
+			m_checksum(format == Gzip ? crc32(0, Z_NULL, 0) : adler32(0, Z_NULL, 0)), m_size(0),
+			m_output(16 * 1024), m_finished(false)
+		{
+			m_stream.zalloc = Z_NULL;
+			m_stream.zfree = Z_NULL;
+			m_stream.opaque = Z_NULL;
+			if (deflateInit2(&m_stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			{
+				throw Exception("Can not initialize deflate stream");
+			}
+			if (m_format == Gzip)
+			{
+				static unsigned char const header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+				m_target->write(reinterpret_cast< char const * >(header), sizeof(header));
+			}
+			else
+			{
+				static unsigned char const header[2] = { 0x78, 0x9c };
+				m_target->write(reinterpret_cast< char const * >(header), sizeof(header));
+			}
+		}
+
+		using Writer::write;
+		using Writer::writeStatic;
+		virtual void write(char const * data, size_t size)
+		{
+			m_checksum = updateChecksum(m_checksum, data, size);
+			m_size += size;
+			deflateData(data, size, Z_NO_FLUSH);
+		}
+		virtual void writeStatic(StaticText const & text)
+		{
+			if (text.size() < m_minPrecompressed)
+			{
+				write(text.data(), text.size());
+				return;
+			}
+			Precompressed const & precompressed = text.derived< Precompressed >(precompressedKey(),
+				std::bind(&GzipWriter::precompress, m_level, std::placeholders::_1));
+			deflateData(nullptr, 0, Z_FULL_FLUSH);
+			m_target->writeStatic(precompressed.data.data(), precompressed.data.size());
+			m_checksum = m_format == Gzip ?
+				crc32_combine(m_checksum, precompressed.crc, static_cast< z_off_t >(text.size())) :
+				adler32_combine(m_checksum, precompressed.adler, static_cast< z_off_t >(text.size()));
+			m_size += text.size();
+		}
+		// Makes everything written so far decompressible by the client.
+		virtual void flushPoint()
+		{
+			deflateData(nullptr, 0, Z_SYNC_FLUSH);
+			m_target->flushPoint();
+		}
+		virtual void flush()
+		{
+			deflateData(nullptr, 0, Z_SYNC_FLUSH);
+			m_target->flush();
+		}
+
+		// Ends the stream with the checksum trailer.
+		void finish()
+		{
+			if (m_finished)
+			{
+				return;
+			}
+			deflateData(nullptr, 0, Z_FINISH);
+			m_finished = true;
+			unsigned char trailer[8];
+			if (m_format == Gzip)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					trailer[i] = static_cast< unsigned char >(m_checksum >> (8 * i));
+					trailer[4 + i] = static_cast< unsigned char >(m_size >> (8 * i));
+				}
+				m_target->write(reinterpret_cast< char const * >(trailer), 8);
+			}
+			else
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					trailer[i] = static_cast< unsigned char >(m_checksum >> (8 * (3 - i)));
+				}
+				m_target->write(reinterpret_cast< char const * >(trailer), 4);
+			}
+		}
+
+		virtual ~GzipWriter()
+		{
+			deflateEnd(&m_stream);
+		}
+
+	private:
+		GzipWriter(GzipWriter const &);
+		GzipWriter & operator=(GzipWriter const &);
+
+	protected:
+		// Deflate blocks of a static text, byte aligned and without the final block flag.
+		struct Precompressed
+		{
+			std::string data;
+			uLong crc;
+			uLong adler;
+		};
+
+		static std::shared_ptr< Precompressed const > precompress(int level, StaticText const & text)
+		{
+			std::shared_ptr< Precompressed > result = std::make_shared< Precompressed >();
+			z_stream stream;
+			stream.zalloc = Z_NULL;
+			stream.zfree = Z_NULL;
+			stream.opaque = Z_NULL;
+			if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			{
+				throw Exception("Can not initialize deflate stream");
+			}
+			// room for the flush marker too
+			result->data.resize(deflateBound(&stream, static_cast< uLong >(text.size())) + 64);
+			stream.next_in = reinterpret_cast< Bytef * >(const_cast< char * >(text.data()));
+			stream.avail_in = static_cast< uInt >(text.size());
+			stream.next_out = reinterpret_cast< Bytef * >(&result->data[0]);
+			stream.avail_out = static_cast< uInt >(result->data.size());
+			int status = deflate(&stream, Z_FULL_FLUSH);
+			bool complete = status == Z_OK && !stream.avail_in && stream.avail_out;
+			result->data.resize(result->data.size() - stream.avail_out);
+			deflateEnd(&stream);
+			if (!complete)
+			{
+				throw Exception("Can not compress static text");
+			}
+			result->crc = crc32(crc32(0, Z_NULL, 0), reinterpret_cast< Bytef const * >(text.data()), static_cast< uInt >(text.size()));
+			result->adler = adler32(adler32(0, Z_NULL, 0), reinterpret_cast< Bytef const * >(text.data()), static_cast< uInt >(text.size()));
+			return result;
+		}
+
+		// One key per compression level, precompressed blocks differ between levels.
+		void const * precompressedKey() const
+		{
+			static char s_keys[11];
+			return &s_keys[m_level < 0 ? 10 : m_level % 10];
+		}
+
+		uLong updateChecksum(uLong checksum, char const * data, size_t size) const
+		{
+			Bytef const * bytes = reinterpret_cast< Bytef const * >(data);
+			return m_format == Gzip ?
+				crc32(checksum, bytes, static_cast< uInt >(size)) :
+				adler32(checksum, bytes, static_cast< uInt >(size));
+		}
+
+		void deflateData(char const * data, size_t size, int flush)
+		{
+			if (m_finished)
+			{
+				throw Exception("Write after the end of the compressed stream");
+			}
+			m_stream.next_in = reinterpret_cast< Bytef * >(const_cast< char * >(data));
+			m_stream.avail_in = static_cast< uInt >(size);
+			do
+			{
+				m_stream.next_out = reinterpret_cast< Bytef * >(&m_output[0]);
+				m_stream.avail_out = static_cast< uInt >(m_output.size());
+				int status = deflate(&m_stream, flush);
+				if (status == Z_STREAM_ERROR)
+				{
+					throw Exception("Deflate failed");
+				}
+				size_t produced = m_output.size() - m_stream.avail_out;
+				if (produced)
+				{
+					m_target->write(&m_output[0], produced);
+				}
+			} while (!m_stream.avail_out || m_stream.avail_in);
+		}
+
+	protected:
+		Writer * m_target;
+		Format m_format;
+		int m_level;
+		size_t m_minPrecompressed;
+		uLong m_checksum;
+		size_t m_size;
+		z_stream m_stream;
+		std::vector< char > m_output;
+		bool m_finished;
+	};
+
+} /* namespace RedZone */
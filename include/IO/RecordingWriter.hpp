@@ -0,0 +1,116 @@
+/*
+ * RecordingWriter.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <IO/StaticText.hpp>
+#include <IO/Writer.hpp>
+
+#include <string>
+#include <vector>
+
+
+namespace GreenZone
+{
+
+	// Records the calls made on it and makes them again, in the same order, on another
+	// writer. Loops and siblings rendered in parallel each render into one and are then
+	// replayed into the target, so static text and flush points reach it as if they had
+	// been rendered there. Copies of the written data are coalesced, static text is only
+	// referenced.
+	class RecordingWriter : public Writer
+	{
+	public:
+		RecordingWriter()
+		{}
+
+		using Writer::write;
+		virtual void write(char const * data, size_t size)
+		{
+			if (m_calls.empty() || m_calls.back().type != Write)
+			{
+				m_calls.push_back(Call(Write, m_buffer.size()));
+			}
+			m_calls.back().size += size;
+			m_buffer.append(data, size);
+		}
+		virtual void writeStatic(char const * data, size_t size)
+		{
+			Call call(WriteStatic, 0);
+			call.data = data;
+			call.size = size;
+			m_calls.push_back(call);
+		}
+		virtual void writeStatic(StaticText const & text)
+		{
+			Call call(WriteStaticText, 0);
+			call.text = &text;
+			m_calls.push_back(call);
+		}
+		virtual void flushPoint()
+		{
+			m_calls.push_back(Call(FlushPoint, 0));
+		}
+		virtual void flush(){}
+
+		// A recorded part is already rendered in parallel with others: what it contains is
+		// rendered in order, one level of parallelism keeps the pool's queue short.
+		virtual bool acceptsReplay() const
+		{
+			return false;
+		}
+
+		void replay(Writer * target) const
+		{
+			for (auto const & call : m_calls)
+			{
+				switch (call.type)
+				{
+				case Write:
+					target->write(m_buffer.data() + call.offset, call.size);
+					break;
+				case WriteStatic:
+					target->writeStatic(call.data, call.size);
+					break;
+				case WriteStaticText:
+					target->writeStatic(*call.text);
+					break;
+				case FlushPoint:
+					target->flushPoint();
+					break;
+				}
+			}
+		}
+
+		virtual ~RecordingWriter(){}
+
+	protected:
+		enum Type
+		{
+			Write,
+			WriteStatic,
+			WriteStaticText,
+			FlushPoint
+		};
+		struct Call
+		{
+			Call(Type type, size_t offset)
+				: type(type), data(nullptr), text(nullptr), offset(offset), size(0)
+			{}
+
+			Type type;
+			char const * data;        // WriteStatic
+			StaticText const * text;  // WriteStaticText
+			size_t offset;            // Write, in m_buffer
+			size_t size;              // Write, WriteStatic
+		};
+
+	protected:
+		std::string m_buffer;
+		std::vector< Call > m_calls;
+	};
+
+} /* namespace RedZone */
@@ -0,0 +1,210 @@
+/*
+ * RopeWriter.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Exception.hpp>
+#include <IO/Writer.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+
+namespace GreenZone
+{
+
+	// Output kept as a list of slices. Static template text is referenced in place,
+	// only dynamic output is copied (into chunks that never move). The slices stay valid
+	// until clear() or destruction of the writer, and as long as the rendered Template
+	// lives. Static text shorter than `minStaticSlice` is copied as well, a slice of a few
+	// bytes costs more than copying them.
+	class RopeWriter : public Writer
+	{
+	public:
+		struct Slice
+		{
+			char const * data;
+			size_t size;
+		};
+
+		explicit RopeWriter(size_t chunkSize = 16 * 1024, size_t minStaticSlice = 64)
+			: m_chunkSize(chunkSize ? chunkSize : 1), m_minStaticSlice(minStaticSlice),
+			m_chunkUsed(0), m_chunkCapacity(0), m_size(0)
+		{}
+
+		using Writer::write;
+		using Writer::writeStatic;
+		virtual void write(char const * data, size_t size)
+		{
+			if (!size)
+			{
+				return;
+			}
+			if (size > m_chunkCapacity - m_chunkUsed)
+			{
+				newChunk(size);
+			}
+			char * target = m_chunks.back().data.get() + m_chunkUsed;
+			std::memcpy(target, data, size);
+			m_chunkUsed += size;
+			append(target, size);
+		}
+		virtual void writeStatic(char const * data, size_t size)
+		{
+			if (size < m_minStaticSlice)
+			{
+				write(data, size);
+				return;
+			}
+			append(data, size);
+		}
+		virtual void flush(){}
+
+		std::vector< Slice > const & slices() const
+		{
+			return m_slices;
+		}
+		size_t size() const
+		{
+			return m_size;
+		}
+		std::string str() const
+		{
+			std::string result;
+			result.reserve(m_size);
+			for (auto const & slice : m_slices)
+			{
+				result.append(slice.data, slice.size);
+			}
+			return result;
+		}
+
+		// Writes all slices to a file descriptor (gathered with writev where available).
+		void flushTo(int fd) const
+		{
+#ifdef _WIN32
+			for (auto const & slice : m_slices)
+			{
+				size_t written = 0;
+				while (written < slice.size)
+				{
+					int result = ::_write(fd, slice.data + written, static_cast< unsigned >(slice.size - written));
+					if (result < 0)
+					{
+						throw IOError("Write failed: " + std::string(std::strerror(errno)));
+					}
+					written += result;
+				}
+			}
+#else
+			std::vector< iovec > vectors;
+			vectors.reserve(m_slices.size());
+			for (auto const & slice : m_slices)
+			{
+				iovec vector = { const_cast< char * >(slice.data), slice.size };
+				vectors.push_back(vector);
+			}
+			size_t next = 0;
+			while (next < vectors.size())
+			{
+				size_t count = std::min< size_t >(vectors.size() - next, IOV_MAX);
+				ssize_t written = ::writev(fd, &vectors[next], static_cast< int >(count));
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					throw IOError("Write failed: " + std::string(std::strerror(errno)));
+				}
+				// skip what was written, a partially written slice is resumed
+				size_t remaining = static_cast< size_t >(written);
+				while (next < vectors.size() && remaining >= vectors[next].iov_len)
+				{
+					remaining -= vectors[next].iov_len;
+					++next;
+				}
+				if (remaining)
+				{
+					vectors[next].iov_base = static_cast< char * >(vectors[next].iov_base) + remaining;
+					vectors[next].iov_len -= remaining;
+				}
+			}
+#endif
+		}
+
+		// Forgets the output but keeps the first chunk for reuse.
+		void clear()
+		{
+			m_slices.clear();
+			if (m_chunks.size() > 1)
+			{
+				m_chunks.resize(1);
+			}
+			m_chunkCapacity = m_chunks.size() ? m_chunks[0].capacity : 0;
+			m_chunkUsed = 0;
+			m_size = 0;
+		}
+
+		virtual ~RopeWriter(){}
+
+	protected:
+		struct Chunk
+		{
+			std::unique_ptr< char[] > data;
+			size_t capacity;
+		};
+
+		void append(char const * data, size_t size)
+		{
+			m_size += size;
+			if (m_slices.size())
+			{
+				Slice & last = m_slices.back();
+				if (last.data + last.size == data)
+				{
+					last.size += size;
+					return;
+				}
+			}
+			Slice slice = { data, size };
+			m_slices.push_back(slice);
+		}
+
+		void newChunk(size_t size)
+		{
+			Chunk chunk;
+			size_t capacity = std::max(size, m_chunkSize);
+			chunk.data.reset(new char[capacity]);
+			chunk.capacity = capacity;
+			m_chunks.push_back(std::move(chunk));
+			m_chunkCapacity = capacity;
+			m_chunkUsed = 0;
+		}
+
+	protected:
+		size_t m_chunkSize;
+		size_t m_minStaticSlice;
+		std::vector< Chunk > m_chunks;
+		size_t m_chunkUsed;
+		size_t m_chunkCapacity;
+		std::vector< Slice > m_slices;
+		size_t m_size;
+	};
+
+} /* namespace RedZone */
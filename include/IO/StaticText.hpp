@@ -0,0 +1,116 @@
+/*
+ * StaticText.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+namespace GreenZone
+{
+
+	// Text of a compiled template. Writers may derive data from it once (e.g. its
+	// compressed form) and keep it with the text for all later renders.
+	class StaticText
+	{
+	public:
+		StaticText()
+			: m_derived(nullptr)
+		{}
+
+		// Only while compiling: derived data is dropped.
+		void assign(std::string const & text)
+		{
+			clearDerived();
+			m_text = text;
+		}
+
+		char const * data() const
+		{
+			return m_text.data();
+		}
+		size_t size() const
+		{
+			return m_text.size();
+		}
+		std::string const & str() const
+		{
+			return m_text;
+		}
+
+		// Data stored under `key` (the address of something owned by the deriving writer),
+		// built by `make` on first use. Lookups take no lock.
+		template< class T >
+		T const & derived(void const * key, std::function< std::shared_ptr< T const >(StaticText const &) > make) const
+		{
+			Derived * found = findDerived(key);
+			if (!found)
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				found = findDerived(key);
+				if (!found)
+				{
+					found = new Derived();
+					found->key = key;
+					found->value = make(*this);
+					found->next = m_derived.load(std::memory_order_relaxed);
+					m_derived.store(found, std::memory_order_release);
+				}
+			}
+			return *static_cast< T const * >(found->value.get());
+		}
+
+		virtual ~StaticText()
+		{
+			clearDerived();
+		}
+
+	private:
+		StaticText(StaticText const &);
+		StaticText & operator=(StaticText const &);
+
+	protected:
+		struct Derived
+		{
+			void const * key;
+			std::shared_ptr< void const > value;
+			Derived * next;
+		};
+
+		Derived * findDerived(void const * key) const
+		{
+			for (Derived * derived = m_derived.load(std::memory_order_acquire); derived; derived = derived->next)
+			{
+				if (derived->key == key)
+				{
+					return derived;
+				}
+			}
+			return nullptr;
+		}
+
+		void clearDerived()
+		{
+			Derived * derived = m_derived.exchange(nullptr);
+			while (derived)
+			{
+				Derived * next = derived->next;
+				delete derived;
+				derived = next;
+			}
+		}
+
+	protected:
+		std::string m_text;
+		mutable std::atomic< Derived * > m_derived;
+		mutable std::mutex m_mutex;
+	};
+
+} /* namespace RedZone */
@@ -20,9 +20,21 @@ namespace GreenZone
 		StringWriter(std::string & string)
 			: m_string(string){}
 
-		virtual void write(std::string const & data)
+		using Writer::write;
+		virtual void write(char const * data, size_t size)
 		{
-			std::copy(data.begin(), data.end(), std::back_inserter(m_string));
+			m_string.append(data, size);
+		}
+		virtual void write(char c)
+		{
+			m_string.push_back(c);
+		}
+		virtual void reserve(size_t size)
+		{
+			if (m_string.capacity() < m_string.size() + size)
+			{
+				m_string.reserve(m_string.size() + size);
+			}
 		}
 		virtual void flush(){}
 
@@ -33,4 +45,3 @@ namespace GreenZone
 	};
 
 } /* namespace RedZone */
-
@@ -0,0 +1,63 @@
+/*
+ * Writer.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <IO/StaticText.hpp>
+
+#include <cstring>
+#include <string>
+
+namespace GreenZone
+{
+
+	class Writer
+	{
+	public:
+		virtual void write(char const * data, size_t size) = 0;
+		virtual void write(char c)
+		{
+			write(&c, 1);
+		}
+		void write(std::string const & data)
+		{
+			write(data.data(), data.size());
+		}
+		void write(char const * data)
+		{
+			write(data, std::strlen(data));
+		}
+		// Text owned by a compiled template, valid for as long as the Template lives.
+		// Writers may keep a reference to it instead of copying.
+		virtual void writeStatic(char const * data, size_t size)
+		{
+			write(data, size);
+		}
+		virtual void writeStatic(StaticText const & text)
+		{
+			writeStatic(text.data(), text.size());
+		}
+		// The output so far is worth sending now (e.g. the end of <head>). Streaming
+		// writers flush here, others ignore it.
+		virtual void flushPoint(){}
+		// Whether loops and siblings may be rendered in parallel into RecordingWriters that
+		// are then replayed here. Writers the nodes must call directly (e.g. to schedule
+		// {% defer %} blocks) get everything rendered in order.
+		virtual bool acceptsReplay() const
+		{
+			return true;
+		}
+		// Hint that about `size` more bytes are going to be written.
+		virtual void reserve(size_t /*size*/){}
+		virtual void flush() = 0;
+
+		virtual ~Writer(){}
+
+	protected:
+		Writer(){}
+	};
+
+} /* namespace RedZone */
@@ -0,0 +1,58 @@
+/*
+ * AutoescapeNode.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Exception.hpp>
+#include <IO/Escape.hpp>
+#include <Node/Node.hpp>
+#include <Parser/Fragment.hpp>
+
+#include <regex>
+
+namespace GreenZone
+{
+
+	// {% autoescape html|attribute|js|url|none %}...{% endautoescape %}
+	class AutoescapeNode : public Node
+	{
+	public:
+		AutoescapeNode()
+			: Node(true), m_mode(EscapeMode::Inherit)
+		{}
+
+		virtual void render(Writer * stream, Context * context) const
+		{
+			renderChildren(stream, context);
+		}
+		virtual void processFragment(Fragment const * fragment)
+		{
+			static std::regex const splitter(R"(^autoescape\s+(\w+)$)");
+			std::smatch match;
+			std::string cleaned = fragment->clean();
+			if (!std::regex_match(cleaned, match, splitter))
+			{
+				throw TemplateSyntaxError(cleaned);
+			}
+			m_mode = escapeModeByName(match[1]);
+		}
+		virtual void exitScope(std::string const & endTag)
+		{
+			if (endTag != "endautoescape")
+				throw TemplateSyntaxError(endTag);
+			// nested autoescape blocks are closed first, their variables keep their mode
+			Node::applyEscapeMode(m_mode);
+		}
+
+		virtual std::string name() const { return "Autoescape"; }
+
+		virtual ~AutoescapeNode(){}
+
+	protected:
+		EscapeMode m_mode;
+	};
+
+} /* namespace RedZone */
@@ -43,10 +43,22 @@ namespace GreenZone
 				throw TemplateSyntaxError(endTag);
 		}
 
+		virtual void collectSegments(std::vector< Node const * > & segments) const
+		{
+			for (auto const & child : m_children)
+			{
+				child->collectSegments(segments);
+			}
+		}
+
 		virtual std::string name() const
 		{
 			return "Block";
 		}
+		virtual bool independent() const
+		{
+			return true;
+		}
 		std::string blockName() const
 		{
 			return m_blockName;
@@ -9,6 +9,7 @@
 #include <Node/Node.hpp>
 #include <Common.hpp>
 #include <Context/Context.hpp>
+#include <Context/ReadSet.hpp>
 #include <Exception.hpp>
 #include <IO/StringWriter.hpp>
 #include <Parser/ExpressionParser.hpp>
@@ -19,6 +20,8 @@
 #include <functional>
 #include <regex>
 #include <chrono>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 
 namespace GreenZone
@@ -31,54 +34,29 @@ namespace GreenZone
 
 		virtual void render(Writer * stream, Context * context) const
 		{
-			static std::unordered_map< size_t, CacheRow > s_cached;
-
 			ExpressionParser parser(context);
 
 			size_t hashValue = 1;
-			static auto hashFunc = std::hash< std::string >();
+			std::hash< std::string > hashFunc;
 
-			for (auto varName : m_vars)
+			for (auto const & varName : m_vars)
 			{
 				json11::Json var = parser.parse(varName);
 				hashValue ^= hashFunc(var.dump());
 			}
 
 			auto now = std::chrono::system_clock::now();
-			auto found = s_cached.find(hashValue);
-
-			auto renderChldrn = [=]() -> std::string
+			Rendered rendered = storage().find(hashValue, now, m_cacheTime);
+			if (!rendered)
 			{
-				std::string rendered;
-				StringWriter writer(rendered);
+				// missing or expired: render and (re)insert
+				std::string fresh;
+				StringWriter writer(fresh);
 				renderChildren(&writer, context);
-				return rendered;
-			};
-			std::string rendered;
-			if (found == s_cached.end())
-			{
-				// insert new element into the cache.
-				rendered = renderChldrn();
-				s_cached[hashValue] = std::make_tuple(now, rendered);
+				rendered = std::make_shared< std::string const >(std::move(fresh));
+				storage().insert(hashValue, std::make_tuple(now, rendered));
 			}
-			else
-			{
-				// element found. Update if necessary.
-				auto row = found->second;
-				auto timePoint = std::get< 0 >(row);
-				auto elapsedMSec = std::chrono::duration_cast<std::chrono::milliseconds>(now - timePoint).count();
-				if (uint64_t(elapsedMSec) >= m_cacheTime)
-				{
-					// re-render
-					rendered = renderChldrn();
-					s_cached[hashValue] = std::make_tuple(now, rendered);
-				}
-				else
-				{
-					rendered = std::get< 1 >(row);
-				}
-			}
-			stream->write(rendered);
+			stream->write(*rendered);
 		}
 
 		virtual void processFragment(Fragment const * fragment)
@@ -112,14 +90,74 @@ namespace GreenZone
 			if (endTag != "endcache")
 				throw TemplateSyntaxError(endTag);
 		}
+		virtual void collectReadSet(ReadSet & readSet) const
+		{
+			std::vector< std::string > variables;
+			for (auto const & varName : m_vars)
+			{
+				ExpressionParser::collectVariables(varName, variables);
+			}
+			for (auto const & variable : variables)
+			{
+				readSet.add(variable);
+			}
+			collectChildren(readSet, m_children);
+		}
 		virtual std::string name() const{ return "Cache"; }
 
 		virtual ~CacheNode(){}
 
+		typedef std::shared_ptr< std::string const > Rendered;
 		typedef std::tuple< std::chrono::time_point<
-			std::chrono::system_clock>, std::string > CacheRow;
+			std::chrono::system_clock>, Rendered > CacheRow;
 
 	protected:
+		// Rendered outputs shared by all cache tags of the process. Split into
+		// independently locked shards so concurrent renders rarely contend.
+		class Storage
+		{
+		public:
+			Rendered find(size_t key, std::chrono::time_point< std::chrono::system_clock > now, uint64_t cacheTime)
+			{
+				Shard & shard = m_shards[key % ShardsCount];
+				std::lock_guard< std::mutex > lock(shard.mutex);
+				auto found = shard.rows.find(key);
+				if (found == shard.rows.end())
+				{
+					return Rendered();
+				}
+				auto elapsedMSec = std::chrono::duration_cast<std::chrono::milliseconds>(
+					now - std::get< 0 >(found->second)).count();
+				if (uint64_t(elapsedMSec) >= cacheTime)
+				{
+					return Rendered();
+				}
+				return std::get< 1 >(found->second);
+			}
+
+			void insert(size_t key, CacheRow const & row)
+			{
+				Shard & shard = m_shards[key % ShardsCount];
+				std::lock_guard< std::mutex > lock(shard.mutex);
+				shard.rows[key] = row;
+			}
+
+		private:
+			enum { ShardsCount = 16 };
+			struct Shard
+			{
+				std::mutex mutex;
+				std::unordered_map< size_t, CacheRow > rows;
+			};
+			Shard m_shards[ShardsCount];
+		};
+
+		static Storage & storage()
+		{
+			static Storage s_storage;
+			return s_storage;
+		}
+
 		uint64_t m_cacheTime;
 		std::vector< std::string > m_vars;
 	};
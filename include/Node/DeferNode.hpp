@@ -0,0 +1,58 @@
+/*
+ * DeferNode.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Exception.hpp>
+#include <IO/DeferredWriter.hpp>
+#include <Parser/Fragment.hpp>
+#include <Node/BlockNode.hpp>
+
+#include <regex>
+
+namespace GreenZone
+{
+
+	// {% defer name %}...{% enddefer %}: a block that a DeferredWriter renders later, in
+	// parallel with the rest of the page. Any other writer gets it rendered in place. It is
+	// a block in every other respect, so it overrides and can be overridden by extends.
+	class DeferNode : public BlockNode
+	{
+	public:
+		virtual void render(Writer * stream, Context * context) const
+		{
+			DeferredWriter * deferredWriter = dynamic_cast< DeferredWriter * >(stream);
+			if (!deferredWriter)
+			{
+				renderChildren(stream, context);
+				return;
+			}
+			deferredWriter->defer([this](Writer * stream, Context * context)
+			{
+				renderChildren(stream, context);
+			}, context);
+		}
+		virtual void processFragment(Fragment const * fragment)
+		{
+			static std::regex const deferSplitter(R"(^defer\s+(\w+)$)");
+			std::smatch match;
+			std::string cleaned = fragment->clean();
+			if (!std::regex_match(cleaned, match, deferSplitter))
+			{
+				throw TemplateSyntaxError(fragment->clean());
+			}
+			m_blockName = match[1];
+		}
+		inline virtual void exitScope(std::string const & endTag)
+		{
+			if (endTag != "enddefer")
+				throw TemplateSyntaxError(endTag);
+		}
+
+		virtual ~DeferNode(){}
+	};
+
+} /* namespace RedZone */
@@ -9,12 +9,17 @@
 
 #include <Common.hpp>
 #include <Context/Context.hpp>
+#include <Context/ReadSet.hpp>
 #include <Exception.hpp>
+#include <IO/RecordingWriter.hpp>
 #include <Parser/ExpressionParser.hpp>
 #include <Parser/Fragment.hpp>
 #include <Node/Node.hpp>
+#include <ThreadPool.hpp>
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <regex>
 
 
@@ -25,45 +30,42 @@ namespace GreenZone
 	class EachNode : public Node
 	{
 	public:
-		EachNode() : Node(true) {}
+		EachNode(size_t parallelThreshold = 0) : Node(true), m_parallelThreshold(parallelThreshold) {}
 
 		virtual void render(Writer * stream, Context * context) const
 		{
-			ExpressionParser parser(context);
-			json11::Json container = parser.parse(m_container);
+			json11::Json container = ExpressionParser::evaluate(m_container, m_containerPath, context);
 			if (!(container.is_array() || container.is_object()))
 			{
 				throw Exception(container.dump() + " is not iterable");
 			}
 
-			json11::Json::object prototype = context->json().object_items();
+			size_t count = container.is_array() ? container.array_items().size() : container.object_items().size();
+			if (!m_parallelThreshold || count < m_parallelThreshold || !stream->acceptsReplay())
+			{
+				renderItems(stream, context, container, 0, count);
+				return;
+			}
 
-			std::shared_ptr< Context > newContext(new Context(prototype));
-			if (container.type() == json11::Json::ARRAY)
+			// large loop: chunks are rendered concurrently into recordings, then replayed in order
+			ThreadPool & pool = ThreadPool::shared();
+			size_t chunkSize = std::max< size_t >(1, count / (4 * pool.size()));
+			std::vector< RecordingWriter > outputs((count + chunkSize - 1) / chunkSize);
+			TaskGroup chunks(pool);
+			for (size_t i = 0; i < outputs.size(); ++i)
 			{
-				json11::Json::array items = container.array_items();
-				for (auto const & item : items)
+				chunks.run([this, i, chunkSize, count, context, &container, &outputs]()
 				{
-					prototype[m_vars[0]] = item;
-					newContext->setJson(json11::Json(prototype));
-					renderChildren(stream, newContext.get());
-				}
+					renderItems(&outputs[i], context, container, i * chunkSize, std::min(count, (i + 1) * chunkSize));
+				});
 			}
-			else if (container.type() == json11::Json::OBJECT)
+			chunks.wait();
+			for (auto const & output : outputs)
 			{
-				json11::Json::object items = container.object_items();
-				for (auto const & item : items)
-				{
-					prototype[m_vars[0]] = item.first;
-					if (m_vars.size() > 1)
-					{
-						prototype[m_vars[1]] = item.second;
-					}
-					newContext->setJson(json11::Json(prototype));
-					renderChildren(stream, newContext.get());
-				}
+				output.replay(stream);
 			}
 		}
+
 		virtual void processFragment(Fragment const * fragment)
 		{
 			static std::regex const splitter(R"(^for\s+(\w[a-zA-Z0-9 _,]*) \s*in\s+(.+)$)");
@@ -85,6 +87,7 @@ namespace GreenZone
 			}
 			m_vars = possibleVars;
 			m_container = match[2];
+			m_containerPath = ExpressionParser::compilePath(m_container);
 		}
 
 		virtual void exitScope(std::string const & endTag)
@@ -92,14 +95,71 @@ namespace GreenZone
 			if (endTag != "endfor")
 				throw TemplateSyntaxError(endTag);
 		}
+		virtual void collectReadSet(ReadSet & readSet) const
+		{
+			std::vector< std::string > variables;
+			ExpressionParser::collectVariables(m_container, variables);
+			std::string container = m_container;
+			trimString(container);
+			bool isPath = variables.size() == 1 && variables[0] == container;
+			if (!isPath)
+			{
+				for (auto const & variable : variables)
+				{
+					readSet.add(variable);
+				}
+			}
+			readSet.enterLoop(m_vars, isPath ? container : std::string());
+			collectChildren(readSet, m_children);
+			readSet.exitLoop();
+		}
+
 		virtual std::string name() const { return "For"; }
 
 
 		virtual ~EachNode(){}
 
+	protected:
+		void renderItems(Writer * stream, Context const * context, json11::Json const & container,
+			size_t from, size_t to) const
+		{
+			json11::Json::object prototype = context->json().object_items();
+
+			// a copy keeps the data providers of the outer context
+			std::shared_ptr< Context > newContext(new Context(*context));
+			if (container.type() == json11::Json::ARRAY)
+			{
+				json11::Json::array const & items = container.array_items();
+				for (size_t i = from; i < to; ++i)
+				{
+					prototype[m_vars[0]] = items[i];
+					newContext->setJson(json11::Json(prototype));
+					renderChildren(stream, newContext.get());
+				}
+			}
+			else if (container.type() == json11::Json::OBJECT)
+			{
+				json11::Json::object const & items = container.object_items();
+				auto item = items.begin();
+				std::advance(item, from);
+				for (size_t i = from; i < to; ++i, ++item)
+				{
+					prototype[m_vars[0]] = item->first;
+					if (m_vars.size() > 1)
+					{
+						prototype[m_vars[1]] = item->second;
+					}
+					newContext->setJson(json11::Json(prototype));
+					renderChildren(stream, newContext.get());
+				}
+			}
+		}
+
 	protected:
 		std::string m_container;
+		Context::Path m_containerPath;
 		std::vector< std::string > m_vars;
+		size_t m_parallelThreshold;  // see Parser::setParallelThreshold()
 	};
 
 } /* namespace RedZone */
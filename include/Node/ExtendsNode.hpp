@@ -27,7 +27,8 @@ namespace GreenZone
 	class ExtendsNode : public Node
 	{
 	public:
-		ExtendsNode() :Node(true) {}
+		// The parent template is compiled by a copy of `parser`, with its options.
+		ExtendsNode(Parser const & parser) :Node(true), m_parser(parser) {}
 
 		virtual void render(Writer * stream, Context * context) const
 		{
@@ -43,18 +44,17 @@ namespace GreenZone
 				throw TemplateSyntaxError(fragment->clean());
 			}
 			std::string path = match[1];
-			std::vector< std::string > const & allParserPaths = Parser::paths();
-			auto found = std::find_if(allParserPaths.begin(), allParserPaths.end(),
+			std::shared_ptr< std::vector< std::string > const > allParserPaths = Parser::paths();
+			auto found = std::find_if(allParserPaths->begin(), allParserPaths->end(),
 				std::bind(&isReadableFile, std::bind(
 				std::function< std::string(std::string const &, std::string const &) >(strConcat), std::placeholders::_1, path)));
-			if (found == allParserPaths.end())
+			if (found == allParserPaths->end())
 			{
 				throw Exception("Extending failed. Cannot open template file " + path);
 			}
 			path = *found + path;
 			FileReader reader(path);  // FIXME: get rid of specific Reader creating
-			static Parser parser;
-			m_parentRoot.reset(parser.loadFromStream(&reader));
+			m_parentRoot.reset(m_parser.loadFromStream(&reader));
 		}
 
 		virtual void exitScope(std::string const & endTag)
@@ -100,12 +100,25 @@ namespace GreenZone
 			}
 		}
 
+		virtual void collectSegments(std::vector< Node const * > & segments) const
+		{
+			for (auto const & node : m_nodesToRender)
+			{
+				node->collectSegments(segments);
+			}
+		}
+		virtual void collectReadSet(ReadSet & readSet) const
+		{
+			collectChildren(readSet, m_nodesToRender);
+		}
+
 		virtual std::string name() const { return "Extends"; }
 
 		virtual ~ExtendsNode(){}
 
 	protected:
 		std::string m_path;
+		Parser m_parser;
 		std::vector< std::shared_ptr< Node > > m_nodesToRender;
 		std::shared_ptr< Root > m_parentRoot;
 	};
@@ -0,0 +1,31 @@
+/*
+ * FlushNode.h
+ *
+ *      Author: jc
+ */
+
+#pragma once
+
+#include <Node/Node.hpp>
+#include <IO/Writer.hpp>
+#include <Parser/Fragment.hpp>
+
+namespace GreenZone
+{
+	class Writer;
+
+	// {% flush %}: marks a point where streaming writers send what was rendered so far.
+	class FlushNode : public Node
+	{
+	public:
+		virtual void render(Writer * stream, Context * /*context*/) const
+		{
+			stream->flushPoint();
+		}
+
+		virtual std::string name() const { return "Flush"; }
+
+		virtual ~FlushNode(){}
+	};
+
+} /* namespace RedZone */
@@ -10,6 +10,7 @@
 #include <Context/json11.hpp>
 #include <Node/Node.hpp>
 #include <Context/Context.hpp>
+#include <Context/ReadSet.hpp>
 #include <Exception.hpp>
 #include <Parser/ExpressionParser.hpp>
 #include <Parser/Fragment.hpp>
@@ -31,15 +32,8 @@ namespace GreenZone
 
 		virtual void render(Writer * stream, Context * context) const
 		{
-			ExpressionParser parser(context);
-			if (parser.parse(m_expression).bool_value())
-			{
-				renderChildren(stream, context, m_ifNodes);
-			}
-			else
-			{
-				renderChildren(stream, context, m_elseNodes);
-			}
+			bool condition = ExpressionParser::evaluate(m_expression, m_path, context).bool_value();
+			renderChildren(stream, context, condition ? m_ifNodes : m_elseNodes);
 		}
 
 		virtual void processFragment(Fragment const * fragment)
@@ -49,6 +43,7 @@ namespace GreenZone
 			m_ifNodes.clear();
 			m_elseNodes.clear();
 			std::copy(clean.begin() + 3, clean.end(), std::back_inserter(m_expression));
+			m_path = ExpressionParser::compilePath(m_expression);
 		}
 
 		virtual void exitScope(std::string const & endTag)
@@ -67,12 +62,24 @@ namespace GreenZone
 			}
 		}
 
+		virtual void collectReadSet(ReadSet & readSet) const
+		{
+			std::vector< std::string > variables;
+			ExpressionParser::collectVariables(m_expression, variables);
+			for (auto const & variable : variables)
+			{
+				readSet.add(variable);
+			}
+			collectChildren(readSet, m_children);
+		}
+
 		virtual std::string name() const{ return "If"; }
 
 		virtual ~IfNode(){}
 
 	protected:
 		std::string m_expression;
+		Context::Path m_path;
 		std::vector< std::shared_ptr< Node > > m_ifNodes;
 		std::vector< std::shared_ptr< Node > > m_elseNodes;
 	};
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <Common.hpp>
+#include <Context/ReadSet.hpp>
 #include <Exception.hpp>
 #include <IO/FileReader.hpp>
 #include <Parser/ExpressionParser.hpp>
@@ -20,8 +21,12 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <regex>
 
 namespace GreenZone
@@ -31,28 +36,20 @@ namespace GreenZone
 	class IncludeNode : public Node
 	{
 	public:
-		IncludeNode() : Node(false){}
+		// Included templates are compiled by a copy of `parser`, with its options.
+		IncludeNode(Parser const & parser)
+			: Node(false), m_parser(parser), m_escapeMode(EscapeMode::Inherit)
+		{}
 
 		virtual void render(Writer * stream, Context * context) const
 		{
 			ExpressionParser exprParser(context);
 			json11::Json paths = exprParser.parse(m_includeExpr);
-			std::vector< std::string > const & allParserPaths = Parser::paths();
 			std::string const wrongArgumentError =
 				"Include expression \"" + m_includeExpr + "\" must be single string or array of strings.";
-			auto rootCreator = [&](std::string path) -> std::shared_ptr< Root >
+			auto rootCreator = [&](std::string const & path) -> std::shared_ptr< Root >
 			{
-				auto found = std::find_if(allParserPaths.begin(), allParserPaths.end(),
-					std::bind(&isReadableFile, std::bind(
-					std::function< std::string(std::string const &, std::string const &) >(strConcat), std::placeholders::_1, path)));
-				if (found == allParserPaths.end())
-				{
-					throw Exception("Include failed. Cannot open template file " + path);
-				}
-				path = *found + path;
-				FileReader reader(path);  // FIXME: get rid of specific Reader creating
-				static Parser parser;
-				return std::shared_ptr< Root >(parser.loadFromStream(&reader));
+				return compiledRoot(path);
 			};
 			std::vector< std::shared_ptr< Root > > roots;
 			if (paths.is_string())
@@ -90,12 +87,134 @@ namespace GreenZone
 		}
 
 
+		// The mode in effect at the include site (the innermost autoescape block, otherwise
+		// the parser default) applies to the variables of the included templates.
+		virtual void applyEscapeMode(EscapeMode mode)
+		{
+			if (m_escapeMode == EscapeMode::Inherit)
+			{
+				m_escapeMode = mode;
+				m_parser.setDefaultEscapeMode(mode);
+			}
+		}
+
+		virtual void collectReadSet(ReadSet & readSet) const
+		{
+			std::vector< std::string > variables;
+			ExpressionParser::collectVariables(m_includeExpr, variables);
+			for (auto const & variable : variables)
+			{
+				readSet.add(variable);
+			}
+			// the included templates are known only at render time
+			readSet.markIncomplete();
+		}
+
 		virtual std::string name() const{ return "Include"; }
+		virtual bool independent() const{ return true; }
 
 		virtual ~IncludeNode(){}
 
+	protected:
+		// Stats of an included file are at least this far apart.
+		static long long reloadCheckIntervalMs() { return 1000; }
+		static long long steadyClockMs()
+		{
+			return std::chrono::duration_cast< std::chrono::milliseconds >(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		struct Compiled
+		{
+			Compiled() : nextCheck(0) {}
+
+			// Whether the file still has the compiled stamp. The file is stat()ed at most once
+			// per interval, by one thread; the others meanwhile assume it unchanged.
+			bool unchanged() const
+			{
+				long long now = steadyClockMs();
+				long long next = nextCheck.load(std::memory_order_relaxed);
+				if (now < next || !nextCheck.compare_exchange_strong(next, now + reloadCheckIntervalMs()))
+				{
+					return true;
+				}
+				return fileStamp(file) == stamp;
+			}
+
+			std::shared_ptr< Root > root;
+			std::string file;
+			FileStamp stamp;
+			mutable std::atomic< long long > nextCheck;
+		};
+		typedef std::map< std::string, std::shared_ptr< Compiled const > > Roots;
+
+		// Included templates are compiled on first use and shared by all later renders,
+		// until their file changes on disk (modification time or size): the first render
+		// that notices it compiles it again. Lookups read an immutable snapshot of the
+		// compiled roots and take no lock; a snapshot is freed with its last reader.
+		// Replaced roots are retired rather than freed: writers may still reference their
+		// static text (see Writer::writeStatic), which stays valid while the Template lives.
+		std::shared_ptr< Root > compiledRoot(std::string const & path) const
+		{
+			std::shared_ptr< Roots const > roots = std::atomic_load(&m_roots);
+			std::shared_ptr< Compiled const > stale;
+			Roots::const_iterator found;
+			if (roots && (found = roots->find(path)) != roots->end())
+			{
+				if (found->second->unchanged())
+				{
+					return found->second->root;
+				}
+				stale = found->second;
+			}
+
+			std::lock_guard< std::mutex > lock(m_rootsMutex);
+			roots = std::atomic_load(&m_roots);
+			// compiled by another thread meanwhile
+			if (roots && (found = roots->find(path)) != roots->end() && found->second != stale)
+			{
+				return found->second->root;
+			}
+			std::shared_ptr< Compiled const > compiled = compile(path);
+			if (roots && found != roots->end())
+			{
+				m_retired.push_back(found->second->root);
+			}
+			std::shared_ptr< Roots > updated = roots ? std::make_shared< Roots >(*roots) : std::make_shared< Roots >();
+			(*updated)[path] = compiled;
+			std::atomic_store(&m_roots, std::shared_ptr< Roots const >(std::move(updated)));
+			return compiled->root;
+		}
+
+		std::shared_ptr< Compiled const > compile(std::string const & path) const
+		{
+			std::shared_ptr< std::vector< std::string > const > allParserPaths = Parser::paths();
+			auto found = std::find_if(allParserPaths->begin(), allParserPaths->end(),
+				std::bind(&isReadableFile, std::bind(
+				std::function< std::string(std::string const &, std::string const &) >(strConcat), std::placeholders::_1, path)));
+			if (found == allParserPaths->end())
+			{
+				throw Exception("Include failed. Cannot open template file " + path);
+			}
+			std::shared_ptr< Compiled > result = std::make_shared< Compiled >();
+			result->file = *found + path;
+			// stamped before reading, so a change made while compiling is seen by a later render
+			result->stamp = fileStamp(result->file);
+			FileReader reader(result->file);  // FIXME: get rid of specific Reader creating
+			result->root.reset(m_parser.loadFromStream(&reader));
+			result->nextCheck.store(steadyClockMs() + reloadCheckIntervalMs(), std::memory_order_relaxed);
+			return result;
+		}
+
 	protected:
 		std::string m_includeExpr;
+		Parser m_parser;
+		EscapeMode m_escapeMode;
+		// read and replaced with std::atomic_load / std::atomic_store
+		mutable std::shared_ptr< Roots const > m_roots;
+		mutable std::mutex m_rootsMutex;
+		// roots replaced by a reload, kept until the node is destroyed; guarded by m_rootsMutex
+		mutable std::vector< std::shared_ptr< Root > > m_retired;
 	};
 
 } /* namespace RedZone */
@@ -8,17 +8,22 @@
 
 #include <Context/json11.hpp>
 #include <Context/Context.hpp>
+#include <IO/Escape.hpp>
+#include <IO/RecordingWriter.hpp>
 #include <IO/Writer.hpp>
+#include <ThreadPool.hpp>
 
 #include <algorithm>
 #include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace GreenZone
 {
 	class Context;
 	class Fragment;
+	class ReadSet;
 	class Writer;
 
 	class Node
@@ -29,16 +34,52 @@ namespace GreenZone
 			stream->write("*** NOT IMPLEMENTED ***");
 		}
 
+		void renderChildren(Writer * stream, Context * context) const
+		{
+			renderChildren(stream, context, m_children);
+		}
+		// Renders the given nodes (e.g. a branch of the children), nothing if there are none.
 		void renderChildren(Writer * stream, Context * context,
-			std::vector< std::shared_ptr< Node > > children = {}) const
+			std::vector< std::shared_ptr< Node > > const & children) const
+		{
+			if (m_parallelSiblings && renderConcurrently(stream, context, children))
+				return;
+			for (auto const & child : children)
+			{
+				child->render(stream, context);
+			}
+		}
+
+		// Sibling blocks and includes are rendered concurrently on ThreadPool::shared(), see
+		// Parser::setParallelSiblings().
+		void setParallelSiblings(bool enabled)
 		{
-			if (!children.size())
-				children = m_children;
-			std::for_each(children.begin(), children.end(),
-				std::bind(&Node::render, std::placeholders::_1, stream, context));
+			m_parallelSiblings = enabled;
 		}
 
 		virtual void processFragment(Fragment const * fragment){}
+
+		// Sets the escaping of the variables below that have none set yet.
+		virtual void applyEscapeMode(EscapeMode mode)
+		{
+			for (auto const & child : m_children)
+			{
+				child->applyEscapeMode(mode);
+			}
+		}
+
+		// Appends the nodes whose outputs, concatenated, make up the output of this one.
+		virtual void collectSegments(std::vector< Node const * > & segments) const
+		{
+			segments.push_back(this);
+		}
+
+		// Adds the context paths this node and its children may read.
+		virtual void collectReadSet(ReadSet & readSet) const
+		{
+			collectChildren(readSet, m_children);
+		}
+
 		void addChild(Node * child)
 		{
 			m_children.push_back(std::shared_ptr< Node >(child));
@@ -51,6 +92,9 @@ namespace GreenZone
 
 		virtual std::string name() const{ return "Node"; }
 
+		// Whether the node may be rendered concurrently with its siblings (blocks and includes).
+		virtual bool independent() const{ return false; }
+
 		std::vector< std::shared_ptr< Node > > const & children(){ return m_children; }
 
 		template< class T >
@@ -70,8 +114,58 @@ namespace GreenZone
 
 	protected:
 		Node(bool createsScope = false)
-			: m_createsScope(createsScope)
+			: m_createsScope(createsScope), m_parallelSiblings(false)
 		{}
+		// Nodes do not modify the context they render (loops render copies of it) and
+		// resolving values is thread-safe, so the siblings share it. Each renders into a
+		// RecordingWriter, replayed into `stream` in order.
+		bool renderConcurrently(Writer * stream, Context * context,
+			std::vector< std::shared_ptr< Node > > const & children) const
+		{
+			auto isIndependent = [](std::shared_ptr< Node > const & node)
+			{
+				return node->independent();
+			};
+			if (!stream->acceptsReplay() || std::count_if(children.begin(), children.end(), isIndependent) < 2)
+			{
+				return false;
+			}
+			std::vector< RecordingWriter > outputs(children.size());
+			TaskGroup subtrees(ThreadPool::shared());
+			for (size_t i = 0; i < children.size(); ++i)
+			{
+				if (isIndependent(children[i]))
+				{
+					Node const * child = children[i].get();
+					RecordingWriter * output = &outputs[i];
+					subtrees.run([child, output, context]()
+					{
+						child->render(output, context);
+					});
+				}
+			}
+			for (size_t i = 0; i < children.size(); ++i)
+			{
+				if (!isIndependent(children[i]))
+				{
+					children[i]->render(&outputs[i], context);
+				}
+			}
+			subtrees.wait();
+			for (auto const & output : outputs)
+			{
+				output.replay(stream);
+			}
+			return true;
+		}
+
+		void collectChildren(ReadSet & readSet, std::vector< std::shared_ptr< Node > > const & children) const
+		{
+			for (auto const & child : children)
+			{
+				child->collectReadSet(readSet);
+			}
+		}
 		virtual json11::Json resolveInContext(std::string const & name, Context const * context) const
 		{
 			return context->resolve(name);
@@ -80,6 +174,7 @@ namespace GreenZone
 	protected:
 		std::vector< std::shared_ptr< Node > > m_children;
 		bool m_createsScope;
+		bool m_parallelSiblings;
 	};
 
 } /* namespace RedZone */
@@ -28,6 +28,14 @@ namespace GreenZone
 			renderChildren(stream, context);
 		}
 
+		virtual void collectSegments(std::vector< Node const * > & segments) const
+		{
+			for (auto const & child : m_children)
+			{
+				child->collectSegments(segments);
+			}
+		}
+
 		virtual std::string name() const
 		{
 			return "Root";
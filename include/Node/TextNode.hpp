@@ -8,9 +8,14 @@
 #pragma once
 
 #include <Node/Node.hpp>
+#include <IO/StaticText.hpp>
 #include <IO/Writer.hpp>
 #include <Parser/Fragment.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <string>
+
 namespace GreenZone
 {
 	class Writer;
@@ -18,17 +23,36 @@ namespace GreenZone
 	class TextNode : public Node
 	{
 	public:
-		TextNode() : Node(){}
+		TextNode() : Node(), m_flushAfterText(false){}
 
 		virtual void render(Writer * stream, Context * context) const
 		{
 			(void)context;
-			stream->write(m_text);
+			stream->writeStatic(m_text);
+			if (m_flushAfterText)
+			{
+				// the head lets the browser start fetching resources, send it right away
+				stream->flushPoint();
+				if (m_rest.size())
+				{
+					stream->writeStatic(m_rest);
+				}
+			}
 		}
 
 		virtual void processFragment(Fragment const * fragment)
 		{
-			m_text = fragment->raw();
+			std::string text = fragment->raw();
+			std::string lowered(text);
+			std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+			size_t headEnd = lowered.find("</head>");
+			m_flushAfterText = headEnd != std::string::npos;
+			if (m_flushAfterText)
+			{
+				m_rest.assign(text.substr(headEnd + 7));
+				text.erase(headEnd + 7);
+			}
+			m_text.assign(text);
 		}
 
 		virtual std::string name() const{ return "Text"; }
@@ -36,7 +60,9 @@ namespace GreenZone
 		virtual ~TextNode(){}
 
 	protected:
-		std::string m_text;
+		StaticText m_text;
+		StaticText m_rest;  // after </head>
+		bool m_flushAfterText;
 	};
 
 } /* namespace RedZone */
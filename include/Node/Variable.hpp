@@ -6,7 +6,16 @@
  */
 #pragma once
 
+#include <Common.hpp>
+#include <Context/Context.hpp>
+#include <Context/ReadSet.hpp>
+#include <IO/Escape.hpp>
+#include <IO/StringWriter.hpp>
 #include <Node/Node.hpp>
+#include <Parser/ExpressionParser.hpp>
+
+#include <string>
+#include <vector>
 
 namespace GreenZone
 {
@@ -15,35 +24,58 @@ namespace GreenZone
 	class Variable : public Node
 	{
 	public:
+		Variable()
+			: m_escapeMode(EscapeMode::Inherit), m_constant(false)
+		{}
+
 		virtual void render(Writer * stream, Context * context) const
 		{
-			ExpressionParser parser(context);
-			json11::Json result = parser.parse(m_expression);
-			switch (result.type())
+			if (m_constant)
 			{
-			case json11::Json::NUL:
-				stream->write("null");
-				break;
-			case json11::Json::NUMBER:
-				stream->write(dbl2str(result.number_value()));
-				break;
-			case json11::Json::STRING:
-				stream->write(result.string_value());
-				break;
-			case json11::Json::BOOL:
-				stream->write(result.bool_value() ? "true" : "false");
-				break;
-			case json11::Json::ARRAY:
-			case json11::Json::OBJECT:
-				stream->write(result.dump());
-				break;
+				stream->writeStatic(m_constantOutput.data(), m_constantOutput.size());
+				return;
 			}
+			writeValue(stream, ExpressionParser::evaluate(m_expression, m_path, context));
 		}
 
 
 		virtual void processFragment(Fragment const * fragment)
 		{
 			m_expression = fragment->clean();
+			// {{ expression|safe }} is never escaped
+			size_t bar = m_expression.rfind('|');
+			if (bar != std::string::npos && bar && m_expression[bar - 1] != '|')
+			{
+				std::string filter = m_expression.substr(bar + 1);
+				trimString(filter);
+				if (filter == "safe")
+				{
+					m_expression.erase(bar);
+					trimString(m_expression);
+					m_escapeMode = EscapeMode::None;
+				}
+			}
+			m_path = ExpressionParser::compilePath(m_expression);
+			evaluateConstant();
+		}
+
+		virtual void applyEscapeMode(EscapeMode mode)
+		{
+			if (m_escapeMode == EscapeMode::Inherit)
+			{
+				m_escapeMode = mode;
+				evaluateConstant();
+			}
+		}
+
+		virtual void collectReadSet(ReadSet & readSet) const
+		{
+			std::vector< std::string > variables;
+			ExpressionParser::collectVariables(m_expression, variables);
+			for (auto const & variable : variables)
+			{
+				readSet.add(variable);
+			}
 		}
 
 		virtual std::string name() const
@@ -54,8 +86,74 @@ namespace GreenZone
 		virtual ~Variable()
 		{}
 
+	protected:
+		void writeValue(Writer * stream, json11::Json const & value) const
+		{
+			switch (value.type())
+			{
+			case json11::Json::NUL:
+				stream->write("null", 4);
+				break;
+			case json11::Json::NUMBER:
+			{
+				char buffer[NumberBufferSize];
+				stream->write(buffer, formatNumber(value, buffer));
+				break;
+			}
+			case json11::Json::STRING:
+			{
+				std::string const & text = value.string_value();
+				Escaper::write(stream, m_escapeMode, text.data(), text.size());
+				break;
+			}
+			case json11::Json::BOOL:
+				if (value.bool_value())
+					stream->write("true", 4);
+				else
+					stream->write("false", 5);
+				break;
+			case json11::Json::ARRAY:
+			case json11::Json::OBJECT:
+			{
+				std::string const text = value.dump();
+				Escaper::write(stream, m_escapeMode, text.data(), text.size());
+				break;
+			}
+			}
+		}
+
+		// Expressions of literals only (no variables, no function calls) are rendered,
+		// and escaped, once at compile time.
+		void evaluateConstant()
+		{
+			m_constant = false;
+			std::vector< std::string > variables;
+			ExpressionParser::collectVariables(m_expression, variables);
+			if (variables.size() || m_expression.find('(') != std::string::npos)
+			{
+				return;
+			}
+			try
+			{
+				Context empty((json11::Json(json11::Json::object())));
+				ExpressionParser parser(&empty);
+				m_constantOutput.clear();
+				StringWriter writer(m_constantOutput);
+				writeValue(&writer, parser.parse(m_expression));
+				m_constant = true;
+			}
+			catch (std::exception const &)
+			{
+				// reported when rendering
+			}
+		}
+
 	protected:
 		std::string m_expression;
+		Context::Path m_path;
+		EscapeMode m_escapeMode;
+		bool m_constant;
+		std::string m_constantOutput;
 	};
 
 } /* namespace RedZone */
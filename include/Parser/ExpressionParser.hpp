@@ -40,7 +40,7 @@ namespace GreenZone
 		ExpressionParser(Context const * context)
 			: m_context(context)
 		{
-			auto binaryOperators = m_context->binaryOperators();
+			auto const & binaryOperators = m_context->binaryOperators();
 			for (auto i = binaryOperators.begin(); i != binaryOperators.end(); ++i)
 			{
 				std::string opString = std::get< 0 >(*i);
@@ -53,19 +53,23 @@ namespace GreenZone
 			{
 				// validating
 				// FIXME: do not count brackets between quotes
-				static std::vector< std::tuple< std::string, char, char > > const validationData
+				static struct
 				{
-					std::make_tuple("Parentheses mismatch", '(', ')'),
-					std::make_tuple("Square brackets mismatch", '[', ']'),
-					std::make_tuple("Braces mismatch", '{', '}'),
-					std::make_tuple("Quotes mismatch", '"', '"'),
+					char const * error;
+					char open, close;
+				} const validationData[] =
+				{
+					{ "Parentheses mismatch", '(', ')' },
+					{ "Square brackets mismatch", '[', ']' },
+					{ "Braces mismatch", '{', '}' },
+					{ "Quotes mismatch", '"', '"' },
 				};
-				for (auto data : validationData)
+				for (auto const & data : validationData)
 				{
-					if (std::count(expression.begin(), expression.end(), std::get< 1 >(data)) !=
-						std::count(expression.begin(), expression.end(), std::get< 2 >(data)))
+					if (std::count(expression.begin(), expression.end(), data.open) !=
+						std::count(expression.begin(), expression.end(), data.close))
 					{
-						throw ExpressionException(expression, std::get< 0 >(data));
+						throw ExpressionException(expression, data.error);
 					}
 				}
 			}
@@ -82,6 +86,78 @@ namespace GreenZone
 			return result;
 		}
 
+		// An expression that is just a variable ("item.name") compiled for evaluate(), which
+		// then looks it up by interned keys. Empty for other expressions.
+		static Context::Path compilePath(std::string expression)
+		{
+			trimString(expression);
+			if (!isVariableName(expression) || expression == "true" || expression == "false" || expression == "null")
+			{
+				return Context::Path();
+			}
+			return Context::compilePath(expression);
+		}
+
+		// Value of `expression`, resolving its compiled path directly when it has one.
+		static json11::Json evaluate(std::string const & expression, Context::Path const & path,
+			Context const * context)
+		{
+			json11::Json value;
+			if (path.size() && context->find(path, value))
+			{
+				return value;
+			}
+			// parsed, for the usual errors
+			return ExpressionParser(context).parse(expression);
+		}
+
+		// Collects the context paths referenced by the expression, without evaluating it.
+		static void collectVariables(std::string const & expression, std::vector< std::string > & variables)
+		{
+			size_t i = 0, len = expression.length();
+			while (i < len)
+			{
+				char current = expression[i];
+				if (current == '"')
+				{
+					for (++i; i < len && expression[i] != '"'; ++i)
+					{
+						if (expression[i] == '\\')
+						{
+							++i;
+						}
+					}
+					++i;
+				}
+				else if (isalpha(current) || current == '_')
+				{
+					size_t start = i;
+					while (i < len && (isalnum(expression[i]) || expression[i] == '_' || expression[i] == '.'))
+					{
+						++i;
+					}
+					std::string name = expression.substr(start, i - start);
+					size_t next = expression.find_first_not_of(" \t\r\n", i);
+					bool isFunction = next != std::string::npos && expression[next] == '(';
+					if (!isFunction && name != "true" && name != "false" && name != "null")
+					{
+						variables.push_back(name);
+					}
+				}
+				else if (isdigit(current))
+				{
+					while (i < len && (isalnum(expression[i]) || expression[i] == '.'))
+					{
+						++i;
+					}
+				}
+				else
+				{
+					++i;
+				}
+			}
+		}
+
 		virtual ~ExpressionParser(){}
 
 	protected:
@@ -100,19 +176,9 @@ namespace GreenZone
 			trimString(expression);
 
 			// perhaps that's a variable
-			static std::regex const variableRegex(R"(^[a-zA-Z_][a-zA-Z_0-9\.]*$)");
-			std::smatch match;
-			if (std::regex_match(expression, match, variableRegex))
+			if (isVariableName(expression) && m_context->find(expression, result))
 			{
-				try
-				{
-					result = m_context->resolve(expression);
-					return result;
-				}
-				catch (TemplateContextError const &)
-				{
-					// FFFFUUUUU~!
-				}
+				return result;
 			}
 
 			// ok... then that's a complex expression, have to parse it... damn! I hate this
@@ -149,17 +215,14 @@ namespace GreenZone
 			// if the expression is a function call
 
 			Context::Functions const & functions = m_context->functions();
-			static std::regex const funcRegex(R"(^(\w+)\s*\((.+)\)$)");
-			std::smatch funcMatch;
-			if (std::regex_match(expression, funcMatch, funcRegex))
+			std::string funcName, argsString;
+			if (splitFunctionCall(expression, funcName, argsString))
 			{
-				std::string funcName = funcMatch[1];
 				Context::Functions::const_iterator foundFunc;
 				if ((foundFunc = functions.find(funcName)) == functions.end())
 				{
 					throw ExpressionException(expression, "No such function: " + funcName);
 				}
-				std::string argsString = funcMatch[2];
 				std::vector< json11::Json > args;
 				int pcount = 0, qbcount = 0, bcount = 0;
 				bool inQuotes = false;
@@ -285,6 +348,38 @@ namespace GreenZone
 			throw ExpressionException(expression, "Wrong syntax or undefined variable");
 		}
 
+		// ^[a-zA-Z_][a-zA-Z_0-9\.]*$
+		static bool isVariableName(std::string const & expression)
+		{
+			if (expression.empty() || !(isalpha(expression[0]) || expression[0] == '_'))
+			{
+				return false;
+			}
+			return std::all_of(expression.begin() + 1, expression.end(), [](char c)
+			{
+				return isalnum(c) || c == '_' || c == '.';
+			});
+		}
+
+		// ^(\w+)\s*\((.+)\)$
+		static bool splitFunctionCall(std::string const & expression, std::string & name, std::string & args)
+		{
+			size_t nameEnd = 0;
+			while (nameEnd < expression.length() && (isalnum(expression[nameEnd]) || expression[nameEnd] == '_'))
+			{
+				++nameEnd;
+			}
+			size_t open = expression.find_first_not_of(" \t\r\n\f\v", nameEnd);
+			if (!nameEnd || open == std::string::npos || expression[open] != '(' ||
+				expression.back() != ')' || open + 2 >= expression.length())
+			{
+				return false;
+			}
+			name = expression.substr(0, nameEnd);
+			args = expression.substr(open + 1, expression.length() - open - 2);
+			return true;
+		}
+
 
 	protected:
 		Context const * m_context;
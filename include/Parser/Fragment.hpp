@@ -6,6 +6,7 @@
  */
 #pragma once
 
+#include <cctype>
 #include <string>
 
 
@@ -15,8 +16,18 @@ namespace GreenZone
 	{
 	public:
 		Fragment(std::string const & rawText)
-			: m_rawText(rawText)
+			: m_rawText(rawText), m_trimsBefore(false), m_trimsAfter(false)
 		{
+			std::string rawStart = m_rawText.substr(0, 2);
+			size_t size = m_rawText.size();
+			if ((rawStart == BLOCK_START_TOKEN || rawStart == VAR_START_TOKEN) && size > 5)
+			{
+				// {%- and -%} (or {{- and -}}) strip the whitespace around the tag. The marker
+				// must be separated from the content by whitespace: {{-5}} and {{ x-}} keep
+				// their meaning.
+				m_trimsBefore = m_rawText[2] == '-' && isspace(static_cast< unsigned char >(m_rawText[3]));
+				m_trimsAfter = m_rawText[size - 3] == '-' && isspace(static_cast< unsigned char >(m_rawText[size - 4]));
+			}
 			m_cleanText = cleanFragment();
 		}
 
@@ -28,6 +39,14 @@ namespace GreenZone
 			{
 				std::string result;
 				std::copy(m_rawText.begin() + 2, m_rawText.end() - 2, std::back_inserter(result));
+				if (m_trimsAfter)
+				{
+					result.pop_back();
+				}
+				if (m_trimsBefore)
+				{
+					result.erase(0, 1);
+				}
 				trimString(result);
 				return result;
 			}
@@ -53,6 +72,20 @@ namespace GreenZone
 		{
 			return m_rawText;
 		}
+		// Replaces the content of a text fragment.
+		void setText(std::string const & text)
+		{
+			m_rawText = text;
+			m_cleanText = text;
+		}
+		bool trimsBefore() const
+		{
+			return m_trimsBefore;
+		}
+		bool trimsAfter() const
+		{
+			return m_trimsAfter;
+		}
 		std::string clean() const
 		{
 			return m_cleanText;
@@ -63,6 +96,8 @@ namespace GreenZone
 	protected:
 		std::string m_rawText;
 		std::string m_cleanText;
+		bool m_trimsBefore;
+		bool m_trimsAfter;
 	};
 
 } /* namespace RedZone */
@@ -7,8 +7,15 @@
 
 #pragma once
 
+#include <Exception.hpp>
+#include <IO/Escape.hpp>
+
+#include <atomic>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 
@@ -35,18 +42,113 @@ namespace GreenZone
 		TextFragment
 	};
 
+	// Compiles templates. The options set on a Parser apply to the templates it loads and,
+	// since they are compiled with a copy of it, to the templates they include or extend.
 	class Parser
 	{
 	public:
+		Parser()
+			: m_parallelThreshold(0), m_parallelSiblings(false), m_defaultEscapeMode(EscapeMode::Inherit),
+			  m_minifyHtml(false)
+		{}
+
 		inline Root * loadFromStream(Reader * stream) const;
 
+		// Loops over at least `items` items are split into chunks rendered on
+		// ThreadPool::shared(). Zero (the default) disables parallel loops.
+		void setParallelThreshold(size_t items)
+		{
+#ifdef JSON11_NONATOMIC_REFCOUNT
+			if (items)
+			{
+				throw Exception("Parallel loops need atomic reference counts, the build defines JSON11_NONATOMIC_REFCOUNT");
+			}
+#endif
+			m_parallelThreshold = items;
+		}
+		size_t parallelThreshold() const
+		{
+			return m_parallelThreshold;
+		}
+		// Sibling blocks and includes are rendered concurrently on ThreadPool::shared().
+		// Within a loop chunk or sibling rendered in parallel, everything is rendered in order.
+		void setParallelSiblings(bool enabled)
+		{
+#ifdef JSON11_NONATOMIC_REFCOUNT
+			if (enabled)
+			{
+				throw Exception("Parallel siblings need atomic reference counts, the build defines JSON11_NONATOMIC_REFCOUNT");
+			}
+#endif
+			m_parallelSiblings = enabled;
+		}
+		bool parallelSiblings() const
+		{
+			return m_parallelSiblings;
+		}
+
+		// Escaping of the variables outside {% autoescape %} blocks. Inherit (the default)
+		// leaves them unescaped. Included templates escape their variables as the variables
+		// at the include site do.
+		void setDefaultEscapeMode(EscapeMode mode)
+		{
+			m_defaultEscapeMode = mode;
+		}
+		EscapeMode defaultEscapeMode() const
+		{
+			return m_defaultEscapeMode;
+		}
+
+		// Collapses whitespace runs of the static text (outside <pre>, <textarea>, <script>,
+		// <style> and quoted attribute values) into one character.
+		void setMinifyHtml(bool enabled)
+		{
+			m_minifyHtml = enabled;
+		}
+		bool minifyHtml() const
+		{
+			return m_minifyHtml;
+		}
+
+		// Template search paths. addPath() publishes a new immutable list, so paths()
+		// may be read from rendering threads without locking. A replaced list is freed
+		// once no reader holds it.
 		inline static void addPath(std::string path);
-		inline static std::vector< std::string >& paths();
+		inline static std::shared_ptr< std::vector< std::string > const > paths();
 
 		virtual ~Parser(){}
 
 	protected:
 		inline Node * createNode(Fragment const * fragment) const;
+		inline void applyWhitespaceControl(std::vector< std::shared_ptr< Fragment > > & fragments) const;
+		// Where the minifier stands at the end of a text fragment, carried over to the next.
+		struct MinifyState
+		{
+			MinifyState() : inTag(false), quote(0) {}
+
+			std::string rawElement;  // element whose content is kept as is (lowercase), or empty
+			bool inTag;              // between the < and > of a tag
+			char quote;              // quote of the attribute value being copied, or 0
+		};
+		inline static void collapseWhitespace(std::string & text, MinifyState & state);
+
+		struct PathsRegistry
+		{
+			PathsRegistry()
+				: current(std::make_shared< std::vector< std::string > const >(1, "./"))
+			{}
+
+			// read and replaced with std::atomic_load / std::atomic_store
+			std::shared_ptr< std::vector< std::string > const > current;
+			std::mutex mutex;
+		};
+		inline static PathsRegistry & pathsRegistry();
+
+	protected:
+		size_t m_parallelThreshold;
+		bool m_parallelSiblings;
+		EscapeMode m_defaultEscapeMode;
+		bool m_minifyHtml;
 	};
 
 } /* namespace RedZone */
@@ -6,6 +6,9 @@
  */
 
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
 #include <regex>
 #include <stack>
@@ -14,11 +17,14 @@
 #include <Common.hpp>
 #include <Exception.hpp>
 #include <IO/Reader.hpp>
+#include <Node/AutoescapeNode.hpp>
 #include <Node/BlockNode.hpp>
 #include <Node/CacheNode.hpp>
+#include <Node/DeferNode.hpp>
 #include <Node/EachNode.hpp>
 #include <Node/ElseNode.hpp>
 #include <Node/ExtendsNode.hpp>
+#include <Node/FlushNode.hpp>
 #include <Node/IfNode.hpp>
 #include <Node/IncludeNode.hpp>
 #include <Node/Root.hpp>
@@ -68,8 +74,10 @@ namespace GreenZone
 			}
 			fragments.push_back(std::make_shared< Fragment >(*iter));
 		}
+		applyWhitespaceControl(fragments);
 
 		Root * root(new Root(stream->id()));
+		root->setParallelSiblings(m_parallelSiblings);
 
 		std::stack< Node * > scopeStack;
 		scopeStack.push(root);
@@ -101,6 +109,10 @@ namespace GreenZone
 		{
 			throw Exception("There is non-closed tag " + scopeStack.top()->name());
 		}
+		if (m_defaultEscapeMode != EscapeMode::Inherit)
+		{
+			root->applyEscapeMode(m_defaultEscapeMode);
+		}
 		return root;
 	}
 
@@ -127,11 +139,14 @@ namespace GreenZone
 			> s_nodeCreators{
 				{ R"(^if\s+.*$)", []() { return new IfNode();      } },
 				{ R"(^else$)", []() { return new ElseNode();    } },
-				{ R"(^for\s+\w[a-zA-Z0-9 _,]* \s*in\s+.+$)", []() { return new EachNode();    } },
-				{ R"(^include\s+.+$)", []() { return new IncludeNode(); } },
+				{ R"(^for\s+\w[a-zA-Z0-9 _,]* \s*in\s+.+$)", [this]() { return new EachNode(m_parallelThreshold); } },
+				{ R"(^include\s+.+$)", [this]() { return new IncludeNode(*this); } },
 				{ R"(^block\s+\w+$)", []() { return new BlockNode();   } },
-				{ R"(^extends\s+.+$)", []() { return new ExtendsNode(); } },
+				{ R"(^extends\s+.+$)", [this]() { return new ExtendsNode(*this); } },
 				{ R"(^cache\s+\d+\s+.+)", []() { return new CacheNode();   } },
+				{ R"(^flush$)", []() { return new FlushNode();   } },
+				{ R"(^defer\s+\w+$)", []() { return new DeferNode();   } },
+				{ R"(^autoescape\s+\w+$)", []() { return new AutoescapeNode(); } },
 			};
 			auto found = std::find_if(s_nodeCreators.begin(), s_nodeCreators.end(), finder);
 			if (found == s_nodeCreators.end()) {
@@ -143,22 +158,149 @@ namespace GreenZone
 		default:
 			throw TemplateSyntaxError(fragment->clean());
 		}
+		node->setParallelSiblings(m_parallelSiblings);
 		node->processFragment(fragment);
 		return node;
 	}
 
+	void Parser::applyWhitespaceControl(std::vector< std::shared_ptr< Fragment > > & fragments) const
+	{
+		static char const * const whitespace = " \t\r\n";
+		MinifyState minifyState;
+		for (size_t i = 0; i < fragments.size(); ++i)
+		{
+			Fragment & fragment = *fragments[i];
+			if (fragment.type() != ElementType::TextFragment)
+			{
+				continue;
+			}
+			bool trimStart = i && fragments[i - 1]->trimsAfter();
+			bool trimEnd = i + 1 < fragments.size() && fragments[i + 1]->trimsBefore();
+			if (!m_minifyHtml && !trimStart && !trimEnd)
+			{
+				continue;
+			}
+			std::string text = fragment.raw();
+			if (m_minifyHtml)
+			{
+				collapseWhitespace(text, minifyState);
+			}
+			if (trimStart)
+			{
+				text.erase(0, text.find_first_not_of(whitespace));
+			}
+			if (trimEnd)
+			{
+				size_t last = text.find_last_not_of(whitespace);
+				text.erase(last == std::string::npos ? 0 : last + 1);
+			}
+			fragment.setText(text);
+		}
+		fragments.erase(std::remove_if(fragments.begin(), fragments.end(),
+			[](std::shared_ptr< Fragment > const & fragment) { return fragment->raw().empty(); }), fragments.end());
+	}
+
+	void Parser::collapseWhitespace(std::string & text, MinifyState & state)
+	{
+		static char const * const rawElements[] = { "pre", "textarea", "script", "style" };
+		std::string lowered(text);
+		std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+		std::string result;
+		result.reserve(text.size());
+		size_t i = 0;
+		while (i < text.size())
+		{
+			if (state.rawElement.size())
+			{
+				size_t end = lowered.find("</" + state.rawElement, i);
+				if (end == std::string::npos)
+				{
+					result.append(text, i, std::string::npos);
+					break;
+				}
+				result.append(text, i, end - i);
+				state.rawElement.clear();
+				i = end;
+				continue;
+			}
+			if (state.quote)
+			{
+				size_t end = text.find(state.quote, i);
+				if (end == std::string::npos)
+				{
+					result.append(text, i, std::string::npos);
+					break;
+				}
+				result.append(text, i, end + 1 - i);
+				state.quote = 0;
+				i = end + 1;
+				continue;
+			}
+			char c = text[i];
+			if (c == '<')
+			{
+				for (auto element : rawElements)
+				{
+					size_t length = std::strlen(element);
+					if (!lowered.compare(i + 1, length, element) && (i + 1 + length == text.size() ||
+						!isalnum(static_cast< unsigned char >(text[i + 1 + length]))))
+					{
+						state.rawElement = element;
+						break;
+					}
+				}
+				state.inTag = state.rawElement.empty() && i + 1 < text.size() &&
+					(text[i + 1] == '/' || isalpha(static_cast< unsigned char >(text[i + 1])));
+				result.push_back(c);
+				++i;
+				continue;
+			}
+			if (state.inTag && (c == '"' || c == '\''))
+			{
+				state.quote = c;
+			}
+			else if (c == '>')
+			{
+				state.inTag = false;
+			}
+			if (!isspace(static_cast< unsigned char >(c)))
+			{
+				result.push_back(c);
+				++i;
+				continue;
+			}
+			bool newline = false;
+			for (; i < text.size() && isspace(static_cast< unsigned char >(text[i])); ++i)
+			{
+				newline = newline || text[i] == '\n';
+			}
+			result.push_back(newline ? '\n' : ' ');
+		}
+		text.swap(result);
+	}
+
 	void Parser::addPath(std::string path)
 	{
 		path = replaceString(path, "\\", "/");
 		if (path.back() != '/')
 			path.push_back('/');
-		paths().push_back(path);
+		PathsRegistry & registry = pathsRegistry();
+		std::lock_guard< std::mutex > lock(registry.mutex);
+		std::shared_ptr< std::vector< std::string > > updated =
+			std::make_shared< std::vector< std::string > >(*std::atomic_load(&registry.current));
+		updated->push_back(path);
+		std::atomic_store(&registry.current, std::shared_ptr< std::vector< std::string > const >(std::move(updated)));
+	}
+
+	std::shared_ptr< std::vector< std::string > const > Parser::paths()
+	{
+		return std::atomic_load(&pathsRegistry().current);
 	}
 
-	std::vector< std::string >& Parser::paths()
+	Parser::PathsRegistry & Parser::pathsRegistry()
 	{
-		static std::vector< std::string > s_paths{ "./", };
-		return s_paths;
+		static PathsRegistry s_registry;
+		return s_registry;
 	}
 
 } /* namespace RedZone */
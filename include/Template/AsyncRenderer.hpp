@@ -0,0 +1,296 @@
+/*
+ * AsyncRenderer.h
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <Context/Context.hpp>
+#include <Context/ReadSet.hpp>
+#include <IO/RecordingWriter.hpp>
+#include <IO/Writer.hpp>
+#include <Node/Node.hpp>
+#include <Template/Template.hpp>
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define GREENZONE_HAS_COROUTINES
+#endif
+#endif
+
+namespace GreenZone
+{
+
+	// Renders a template without blocking on the data providers of the context. The
+	// output is split into segments (the top level nodes, with blocks and extends
+	// flattened); a segment reading a value that has not arrived yet is suspended and
+	// resumed by the provider delivering it, while the segments that do not depend on it
+	// are rendered in the meantime. Segments rendered ahead of their turn are recorded
+	// and replayed, so the stream receives the output in order.
+	class AsyncRenderer : public std::enable_shared_from_this< AsyncRenderer >
+	{
+	public:
+		typedef std::function< void(std::exception_ptr) > Done;
+
+		// Starts rendering and returns once every segment is rendered or waits for a
+		// provider. `done` is called once, on the thread that rendered the last segment,
+		// with the exception that stopped rendering if any. The stream and the context
+		// must stay valid until then.
+		static void render(Template const & tpl, Writer * stream, Context * context, Done done)
+		{
+			std::shared_ptr< AsyncRenderer > renderer(new AsyncRenderer(tpl, stream, context, done));
+			renderer->resume();
+		}
+
+		virtual ~AsyncRenderer(){}
+
+	protected:
+		struct Segment
+		{
+			Segment()
+				: node(nullptr), rendered(false)
+			{}
+
+			Node const * node;
+			std::vector< std::string > names;  // top level values read
+			bool rendered;
+			std::shared_ptr< RecordingWriter > recording;  // rendered ahead of its turn
+		};
+
+		AsyncRenderer(Template const & tpl, Writer * stream, Context * context, Done done)
+			: m_root(tpl.root()), m_stream(stream), m_context(context), m_done(done),
+			  m_next(0), m_running(false), m_again(false), m_finished(false)
+		{
+			std::vector< Node const * > nodes;
+			m_root->collectSegments(nodes);
+			for (auto node : nodes)
+			{
+				ReadSet readSet;
+				node->collectReadSet(readSet);
+				Segment segment;
+				segment.node = node;
+				if (readSet.complete())
+				{
+					std::set< std::string > names;
+					for (auto const & path : readSet.paths())
+					{
+						names.insert(path.substr(0, path.find('.')));
+					}
+					segment.names.assign(names.begin(), names.end());
+				}
+				else
+				{
+					segment.names = context->providerNames();
+				}
+				m_segments.push_back(segment);
+			}
+			stream->reserve(tpl.outputSizeHint());
+		}
+
+		// Runs step() on one thread at a time: a provider arriving while it runs has it
+		// run again by the same thread.
+		void resume()
+		{
+			{
+				std::lock_guard< std::mutex > lock(m_mutex);
+				if (m_running || m_finished)
+				{
+					m_again = true;
+					return;
+				}
+				m_running = true;
+			}
+			std::shared_ptr< AsyncRenderer > self = shared_from_this();
+			while (true)
+			{
+				std::exception_ptr error;
+				bool finished = false;
+				try
+				{
+					finished = step();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+					finished = true;
+				}
+				{
+					std::lock_guard< std::mutex > lock(m_mutex);
+					if (!finished && m_again)
+					{
+						m_again = false;
+						continue;
+					}
+					m_running = false;
+					m_finished = finished;
+				}
+				if (finished)
+				{
+					m_done(error);
+				}
+				return;
+			}
+		}
+
+		// Renders the segments whose values have all arrived. True once all are rendered.
+		bool step()
+		{
+			for (size_t i = m_next; i < m_segments.size(); ++i)
+			{
+				Segment & segment = m_segments[i];
+				if (segment.rendered || !arrived(segment))
+				{
+					continue;
+				}
+				if (i == m_next)
+				{
+					segment.node->render(m_stream, m_context);
+				}
+				else
+				{
+					segment.recording = std::make_shared< RecordingWriter >();
+					segment.node->render(segment.recording.get(), m_context);
+				}
+				segment.rendered = true;
+				while (m_next < m_segments.size() && m_segments[m_next].rendered)
+				{
+					if (m_segments[m_next].recording)
+					{
+						m_segments[m_next].recording->replay(m_stream);
+						m_segments[m_next].recording.reset();
+					}
+					++m_next;
+				}
+			}
+			return m_next == m_segments.size();
+		}
+
+		// Whether the segment can be rendered without waiting. Each missing value is
+		// waited for once, whichever segments read it.
+		bool arrived(Segment const & segment)
+		{
+			bool result = true;
+			for (auto const & name : segment.names)
+			{
+				{
+					std::lock_guard< std::mutex > lock(m_mutex);
+					if (m_waiting.count(name))
+					{
+						result = false;
+						continue;
+					}
+					m_waiting.insert(name);
+				}
+				std::shared_ptr< AsyncRenderer > self = shared_from_this();
+				bool const ready = m_context->whenProvided(name, [self, name]()
+				{
+					{
+						std::lock_guard< std::mutex > lock(self->m_mutex);
+						self->m_waiting.erase(name);
+					}
+					self->resume();
+				});
+				if (ready)
+				{
+					std::lock_guard< std::mutex > lock(m_mutex);
+					m_waiting.erase(name);
+				}
+				result = result && ready;
+			}
+			return result;
+		}
+
+	protected:
+		std::shared_ptr< Root const > m_root;
+		Writer * m_stream;
+		Context * m_context;
+		Done m_done;
+		std::vector< Segment > m_segments;
+		size_t m_next;  // first segment not written to the stream yet
+
+		std::mutex m_mutex;
+		std::set< std::string > m_waiting;
+		bool m_running;
+		bool m_again;
+		bool m_finished;
+	};
+
+#ifdef GREENZONE_HAS_COROUTINES
+	// `co_await renderAsync(tpl, &stream, &context);` in a C++20 coroutine renders with
+	// AsyncRenderer, suspending the coroutine until the output is complete. It is resumed
+	// on the thread that rendered the last segment, and not suspended at all if no value
+	// had to be waited for. The errors of the render are rethrown there.
+	class RenderAwaiter
+	{
+	public:
+		RenderAwaiter(Template const & tpl, Writer * stream, Context * context)
+			: m_template(&tpl), m_stream(stream), m_context(context), m_state(std::make_shared< State >())
+		{}
+
+		bool await_ready() const
+		{
+			return false;
+		}
+		bool await_suspend(std::coroutine_handle<> handle)
+		{
+			std::shared_ptr< State > state = m_state;
+			state->handle = handle;
+			AsyncRenderer::render(*m_template, m_stream, m_context, [state](std::exception_ptr error)
+			{
+				state->error = error;
+				if (state->phase.exchange(Done) == Suspended)
+				{
+					state->handle.resume();
+				}
+			});
+			return state->phase.exchange(Suspended) != Done;
+		}
+		void await_resume() const
+		{
+			if (m_state->error)
+			{
+				std::rethrow_exception(m_state->error);
+			}
+		}
+
+	protected:
+		enum Phase
+		{
+			Rendering,
+			Suspended,
+			Done
+		};
+		struct State
+		{
+			State()
+				: phase(Rendering)
+			{}
+
+			std::atomic< Phase > phase;
+			std::coroutine_handle<> handle;
+			std::exception_ptr error;
+		};
+
+		Template const * m_template;
+		Writer * m_stream;
+		Context * m_context;
+		std::shared_ptr< State > m_state;
+	};
+
+	inline RenderAwaiter renderAsync(Template const & tpl, Writer * stream, Context * context)
+	{
+		return RenderAwaiter(tpl, stream, context);
+	}
+#endif
+
+} /* namespace RedZone */
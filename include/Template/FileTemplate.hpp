@@ -6,7 +6,7 @@
  */
 #pragma once
 
-#include <Template/template.hpp>
+#include <Template/Template.hpp>
 
 #include <string>
 
@@ -16,11 +16,11 @@ namespace GreenZone
 	class FileTemplate : public Template
 	{
 	public:
-		FileTemplate(std::string const & filePath)
+		FileTemplate(std::string const & filePath, Parser const & parser = Parser())
 			: m_filePath(filePath)
 		{
 			FileReader in(filePath);
-			loadFromStream(&in);
+			loadFromStream(&in, parser);
 		}
 		virtual ~FileTemplate()
 		{}
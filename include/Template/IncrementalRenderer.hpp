@@ -0,0 +1,197 @@
+/*
+ * IncrementalRenderer.h
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <Context/Context.hpp>
+#include <Context/json11.hpp>
+#include <Context/ReadSet.hpp>
+#include <Exception.hpp>
+#include <IO/StringWriter.hpp>
+#include <Node/Node.hpp>
+#include <Template/Template.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace GreenZone
+{
+
+	// Keeps the output of a template split into segments (the top level nodes, with
+	// blocks and extends flattened) together with the context paths each segment reads,
+	// so that a context change re-renders only the segments it affects.
+	class IncrementalRenderer
+	{
+	public:
+		// Replacement of one segment. Applying the patches of an update in order to the
+		// previous output, `length` bytes at `offset` are replaced by `text`.
+		struct Patch
+		{
+			size_t segment;
+			size_t offset;
+			size_t length;
+			std::string text;
+		};
+
+		IncrementalRenderer(Template const & tpl, json11::Json const & context)
+			: m_root(tpl.root()), m_context(context)
+		{
+			std::vector< Node const * > nodes;
+			m_root->collectSegments(nodes);
+			for (auto node : nodes)
+			{
+				Segment segment;
+				segment.node = node;
+				node->collectReadSet(segment.readSet);
+				segment.output = renderSegment(node);
+				m_segments.push_back(segment);
+			}
+			rebuildOutput();
+		}
+
+		std::string const & output() const
+		{
+			return m_output;
+		}
+		json11::Json context() const
+		{
+			return m_context.json();
+		}
+		size_t segmentsCount() const
+		{
+			return m_segments.size();
+		}
+		std::string const & segment(size_t index) const
+		{
+			return m_segments.at(index).output;
+		}
+
+		// Applies `diff` to the context as a JSON merge patch (RFC 7386: objects are merged
+		// recursively, null removes a member, anything else replaces the value) and
+		// re-renders the segments reading any of the changed paths.
+		std::vector< Patch > update(json11::Json const & diff)
+		{
+			if (!diff.is_object())
+			{
+				throw JsonError("Context diff must be presented in dictionary type.");
+			}
+			std::vector< std::string > changed;
+			collectChanges(m_context.json(), diff, "", changed);
+			m_context.setJson(mergePatch(m_context.json(), diff));
+
+			std::vector< Patch > patches;
+			size_t offset = 0;
+			for (size_t i = 0; i < m_segments.size(); ++i)
+			{
+				Segment & segment = m_segments[i];
+				bool affected = false;
+				for (auto const & path : changed)
+				{
+					if (segment.readSet.touches(path))
+					{
+						affected = true;
+						break;
+					}
+				}
+				if (affected)
+				{
+					std::string rendered = renderSegment(segment.node);
+					if (rendered != segment.output)
+					{
+						Patch patch = { i, offset, segment.output.size(), rendered };
+						patches.push_back(patch);
+						segment.output.swap(rendered);
+					}
+				}
+				offset += segment.output.size();
+			}
+			if (patches.size())
+			{
+				rebuildOutput();
+			}
+			return patches;
+		}
+
+		virtual ~IncrementalRenderer(){}
+
+	protected:
+		struct Segment
+		{
+			Node const * node;
+			ReadSet readSet;
+			std::string output;
+		};
+
+		std::string renderSegment(Node const * node)
+		{
+			std::string result;
+			StringWriter writer(result);
+			node->render(&writer, &m_context);
+			return result;
+		}
+
+		void rebuildOutput()
+		{
+			size_t size = 0;
+			for (auto const & segment : m_segments)
+			{
+				size += segment.output.size();
+			}
+			m_output.clear();
+			m_output.reserve(size);
+			for (auto const & segment : m_segments)
+			{
+				m_output += segment.output;
+			}
+		}
+
+		static json11::Json mergePatch(json11::Json const & target, json11::Json const & patch)
+		{
+			if (!patch.is_object())
+			{
+				return patch;
+			}
+			json11::Json::object result = target.object_items();
+			for (auto const & item : patch.object_items())
+			{
+				if (item.second.is_null())
+				{
+					result.erase(item.first);
+				}
+				else
+				{
+					result[item.first] = mergePatch(target[item.first], item.second);
+				}
+			}
+			return json11::Json(result);
+		}
+
+		static void collectChanges(json11::Json const & target, json11::Json const & patch,
+			std::string const & prefix, std::vector< std::string > & changed)
+		{
+			for (auto const & item : patch.object_items())
+			{
+				std::string path = prefix + item.first;
+				json11::Json const & current = target[item.first];
+				if (item.second.is_object() && current.is_object())
+				{
+					collectChanges(current, item.second, path + ".", changed);
+				}
+				else if (item.second != current)
+				{
+					changed.push_back(path);
+				}
+			}
+		}
+
+	protected:
+		std::shared_ptr< Root const > m_root;
+		Context m_context;
+		std::vector< Segment > m_segments;
+		std::string m_output;
+	};
+
+} /* namespace RedZone */
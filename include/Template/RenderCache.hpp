@@ -0,0 +1,114 @@
+/*
+ * RenderCache.h
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace GreenZone
+{
+
+	// Bounded LRU storage for whole rendered outputs, keyed by the context values they were
+	// rendered from. Entries are indexed by the hash of their key and the key is compared on
+	// a hit, so a hash collision is a miss, never another context's output.
+	class RenderCache
+	{
+	public:
+		struct Stats
+		{
+			size_t hits;
+			size_t misses;
+			size_t evictions;
+			size_t size;
+			size_t capacity;
+		};
+
+		RenderCache(size_t capacity)
+			: m_capacity(capacity), m_hits(0), m_misses(0), m_evictions(0)
+		{}
+
+		bool find(std::string const & key, std::string & output)
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			auto found = m_index.find(hash(key));
+			if (found == m_index.end() || found->second->key != key)
+			{
+				++m_misses;
+				return false;
+			}
+			++m_hits;
+			m_entries.splice(m_entries.begin(), m_entries, found->second);
+			output = found->second->output;
+			return true;
+		}
+
+		// An entry whose key has the same hash is replaced.
+		void insert(std::string const & key, std::string const & output)
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			size_t const keyHash = hash(key);
+			auto found = m_index.find(keyHash);
+			if (found != m_index.end())
+			{
+				found->second->key = key;
+				found->second->output = output;
+				m_entries.splice(m_entries.begin(), m_entries, found->second);
+				return;
+			}
+			Entry entry = { keyHash, key, output };
+			m_entries.push_front(entry);
+			m_index[keyHash] = m_entries.begin();
+			while (m_entries.size() > m_capacity)
+			{
+				m_index.erase(m_entries.back().hash);
+				m_entries.pop_back();
+				++m_evictions;
+			}
+		}
+
+		void clear()
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			m_entries.clear();
+			m_index.clear();
+		}
+
+		Stats stats() const
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			Stats result = { m_hits, m_misses, m_evictions, m_entries.size(), m_capacity };
+			return result;
+		}
+
+		virtual ~RenderCache(){}
+
+	protected:
+		struct Entry
+		{
+			size_t hash;
+			std::string key;
+			std::string output;
+		};
+		typedef std::list< Entry > Entries;
+
+		static size_t hash(std::string const & key)
+		{
+			return std::hash< std::string >()(key);
+		}
+
+		size_t m_capacity;
+		size_t m_hits;
+		size_t m_misses;
+		size_t m_evictions;
+		Entries m_entries;
+		std::unordered_map< size_t, Entries::iterator > m_index;
+		mutable std::mutex m_mutex;
+	};
+
+} /* namespace RedZone */
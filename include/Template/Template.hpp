@@ -6,11 +6,21 @@
  */
 #pragma once
 
+#include <Context/ReadSet.hpp>
 #include <Node/Root.hpp>
-#include <IO/stringwriter.hpp>
+#include <IO/BufferPool.hpp>
+#include <IO/StringWriter.hpp>
 #include <Parser/Parser.hpp>
+#include <Template/RenderCache.hpp>
+#include <ThreadPool.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -23,6 +33,16 @@ namespace GreenZone
 	class Root;
 	class Writer;
 
+	// A compiled template is immutable: render() and renderToStream() may be called on
+	// the same Template from any number of threads at once, each with its own Context and
+	// Writer. Rendering takes no locks except when compiling an included template (on first
+	// use or after its file changed), looking up {% cache %} entries and when memoization is
+	// enabled.
+	// Requires thread-safe initialization of function-local statics (C++11 "magic
+	// statics", Visual Studio 2015 or later).
+	// Builds defining JSON11_NONATOMIC_REFCOUNT must render each context on one thread:
+	// parallel loops and siblings, deferred blocks and data providers throw an Exception
+	// when enabled, renderBatch() does not compile, and contexts must not be shared.
 	class Template
 	{
 	public:
@@ -31,27 +51,320 @@ namespace GreenZone
 
 		void renderToStream(Writer * stream, Context * context) const
 		{
+			if (context->hasProviders())
+			{
+				prefetch(*context);
+			}
+			stream->reserve(outputSizeHint());
 			m_root->render(stream, context);
 		}
 		std::string render(Context * context) const
 		{
 			std::string result;
-			StringWriter stringWriter(result);
+			render(context, result);
+			return result;
+		}
+		// Renders into `output`, replacing its content but reusing its storage.
+		void render(Context * context, std::string & output) const
+		{
+			output.clear();
+			std::string key;
+			bool const memoize = m_renderCache && m_readSet.complete() && !context->hasProviders();
+			if (memoize)
+			{
+				key = m_readSet.key(*context);
+				if (m_renderCache->find(key, output))
+				{
+					return;
+				}
+			}
+			StringWriter stringWriter(output);
 			renderToStream(&stringWriter, context);
+			updateOutputSizeHint(output.size());
+			if (memoize)
+			{
+				m_renderCache->insert(key, output);
+			}
+		}
+
+		// Renders into a buffer of the calling thread's BufferPool, so steady-state
+		// rendering does not allocate output memory (for outputs below BufferPool::MaxBytes).
+		PooledString renderPooled(Context * context) const
+		{
+			PooledString result(outputSizeHint());
+			render(context, result.str());
 			return result;
 		}
 
+		// Expected output size: moving average of the outputs rendered by render(), plus
+		// 1/8 for growth. Writers are asked to reserve it before rendering.
+		size_t outputSizeHint() const
+		{
+			size_t average = m_averageSize.load(std::memory_order_relaxed);
+			return average + average / 8;
+		}
+
+		struct BatchOptions
+		{
+			BatchOptions()
+				: pool(nullptr), ordered(true), maxInFlight(0)
+			{}
+
+			ThreadPool * pool;   // ThreadPool::shared() if null
+			bool ordered;        // outputs reach the sink in input order, otherwise as completed
+			size_t maxInFlight;  // contexts taken from the input ahead of the sink, 4 per thread if zero
+		};
+		struct BatchStats
+		{
+			size_t renders;  // outputs passed to the sink
+			size_t bytes;
+			double seconds;
+
+			double rendersPerSecond() const { return seconds > 0 ? renders / seconds : 0; }
+			double bytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0; }
+		};
+
+		// Renders every context of [first, last) on a thread pool and calls
+		// sink(size_t index, std::string const & output) for each of them, one call at a
+		// time. Contexts (Context & or Context * items) are taken from the input on the
+		// calling thread, only while fewer than maxInFlight outputs wait for the sink,
+		// and must stay valid until their output has been passed to it.
+		template< class InputIterator, class Sink >
+		BatchStats renderBatch(InputIterator first, InputIterator last, Sink sink,
+			BatchOptions const & options = BatchOptions()) const
+		{
+#ifdef JSON11_NONATOMIC_REFCOUNT
+			static_assert(sizeof(Sink) == 0, "renderBatch needs atomic reference counts, the build defines JSON11_NONATOMIC_REFCOUNT");
+#endif
+			ThreadPool & pool = options.pool ? *options.pool : ThreadPool::shared();
+			size_t const maxInFlight = options.maxInFlight ? options.maxInFlight : 4 * pool.size();
+			auto const start = std::chrono::steady_clock::now();
+
+			BatchState state;
+			std::mutex sinkMutex;
+			TaskGroup tasks(pool);
+			size_t index = 0;
+			for (; first != last; ++first, ++index)
+			{
+				{
+					std::unique_lock< std::mutex > lock(state.mutex);
+					while (state.inFlight >= maxInFlight && !state.error)
+					{
+						lock.unlock();
+						bool const ran = tasks.runPendingTask();
+						lock.lock();
+						if (!ran)
+						{
+							// every task is running: a finished one frees a slot and signals it
+							state.progress.wait(lock, [&state, maxInFlight]() { return state.inFlight < maxInFlight || state.error; });
+						}
+					}
+					if (state.error)
+					{
+						break;
+					}
+					++state.inFlight;
+				}
+				Context * context = batchContext(*first);
+				bool const ordered = options.ordered;
+				tasks.run([this, context, index, ordered, &state, &sinkMutex, &sink]()
+				{
+					try
+					{
+						// a buffer of the task's own from the thread's BufferPool: a thread waiting
+						// in the middle of a render may run another task before coming back to it
+						std::string rendered = BufferPool::acquire();
+						render(context, rendered);
+						if (!ordered)
+						{
+							{
+								std::lock_guard< std::mutex > lock(sinkMutex);
+								sink(index, static_cast< std::string const & >(rendered));
+							}
+							state.completed(rendered.size());
+							BufferPool::release(rendered, outputSizeHint());
+							return;
+						}
+						{
+							std::lock_guard< std::mutex > lock(state.mutex);
+							state.ready[index].swap(rendered);
+						}
+						// whoever holds the sink emits everything that is next in order
+						std::lock_guard< std::mutex > sinkLock(sinkMutex);
+						while (true)
+						{
+							std::string output;
+							size_t emitted;
+							{
+								std::lock_guard< std::mutex > lock(state.mutex);
+								auto next = state.ready.find(state.nextToEmit);
+								if (next == state.ready.end())
+								{
+									break;
+								}
+								emitted = next->first;
+								output.swap(next->second);
+								state.ready.erase(next);
+								++state.nextToEmit;
+							}
+							sink(emitted, static_cast< std::string const & >(output));
+							state.completed(output.size());
+							BufferPool::release(output, outputSizeHint());
+						}
+					}
+					catch (...)
+					{
+						std::lock_guard< std::mutex > lock(state.mutex);
+						if (!state.error)
+						{
+							state.error = std::current_exception();
+						}
+						state.progress.notify_all();
+					}
+				});
+			}
+			tasks.wait();
+			if (state.error)
+			{
+				std::rethrow_exception(state.error);
+			}
+
+			BatchStats stats = { state.renders, state.bytes,
+				std::chrono::duration_cast< std::chrono::duration< double > >(std::chrono::steady_clock::now() - start).count() };
+			return stats;
+		}
+
+		std::shared_ptr< Root const > root() const
+		{
+			return m_root;
+		}
+
+		// Context paths the template may read, see ReadSet.
+		ReadSet readSet() const
+		{
+			ReadSet result;
+			m_root->collectReadSet(result);
+			return result;
+		}
+
+		// The context data the template may read, for parsing only that part of large
+		// data: Context(json, tpl.projection()).
+		json11::Projection const & projection() const
+		{
+			return m_projection;
+		}
+
+		// Memoizes up to `capacity` outputs of render(), keyed by the values of readSet()
+		// in the context. Zero disables memoization. Templates producing different output
+		// for the same data (e.g. using random()) should not be memoized. Contexts with
+		// data providers, and templates whose read set is not complete (e.g. with includes),
+		// are always rendered.
+		void setMemoization(size_t capacity)
+		{
+			if (!capacity)
+			{
+				m_renderCache.reset();
+				return;
+			}
+			m_renderCache = std::make_shared< RenderCache >(capacity);
+		}
+		RenderCache::Stats memoizationStats() const
+		{
+			if (!m_renderCache)
+			{
+				RenderCache::Stats empty = { 0, 0, 0, 0, 0 };
+				return empty;
+			}
+			return m_renderCache->stats();
+		}
+
 	protected:
+		struct BatchState
+		{
+			BatchState()
+				: inFlight(0), nextToEmit(0), renders(0), bytes(0)
+			{}
+
+			void completed(size_t outputSize)
+			{
+				std::lock_guard< std::mutex > lock(mutex);
+				--inFlight;
+				++renders;
+				bytes += outputSize;
+				progress.notify_all();
+			}
+
+			std::mutex mutex;
+			std::condition_variable progress;
+			size_t inFlight;
+			size_t nextToEmit;
+			size_t renders;
+			size_t bytes;
+			std::map< size_t, std::string > ready;
+			std::exception_ptr error;
+		};
+
+		// Concurrent renders may overwrite each other's update, which is fine for a hint.
+		void updateOutputSizeHint(size_t size) const
+		{
+			size_t average = m_averageSize.load(std::memory_order_relaxed);
+			if (!average)
+			{
+				average = size;
+			}
+			else if (size > average)
+			{
+				average += (size - average + 7) / 8;
+			}
+			else
+			{
+				average -= (average - size) / 8;
+			}
+			m_averageSize.store(average, std::memory_order_relaxed);
+		}
+
+		static Context * batchContext(Context & context)
+		{
+			return &context;
+		}
+		static Context * batchContext(Context * context)
+		{
+			return context;
+		}
+
 		Template()
+			: m_averageSize(0)
 		{}
-		void loadFromStream(Reader * stream)
+		void loadFromStream(Reader * stream, Parser const & parser = Parser())
 		{
-			Parser parser;
 			m_root.reset(parser.loadFromStream(stream));
+			m_readSet = readSet();
+			m_projection = m_readSet.projection();
+		}
+
+		// Starts the data providers the template reads, so they are fetched concurrently
+		// while rendering proceeds up to the first value it has to wait for.
+		void prefetch(Context const & context) const
+		{
+			if (!m_readSet.complete())
+			{
+				context.prefetchAll();
+				return;
+			}
+			std::vector< std::string > names;
+			for (auto const & path : m_readSet.paths())
+			{
+				names.push_back(path.substr(0, path.find('.')));
+			}
+			context.prefetch(names);
 		}
 
 	protected:
 		std::shared_ptr< Root const > m_root;
+		ReadSet m_readSet;
+		json11::Projection m_projection;
+		std::shared_ptr< RenderCache > m_renderCache;
+		mutable std::atomic< size_t > m_averageSize;
 	};
 
 } /* namespace RedZone */
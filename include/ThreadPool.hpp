@@ -0,0 +1,294 @@
+/*
+ * ThreadPool.h
+ *
+ *      Author: jc
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GreenZone
+{
+
+	// Work-stealing thread pool. Every worker has its own queue: it takes its newest task
+	// first and, when idle, steals the oldest tasks of the others. Threads waiting for
+	// results should submit through a TaskGroup, which runs its own tasks while waiting,
+	// instead of blocking on tasks the pool may never get to.
+	class ThreadPool
+	{
+	public:
+		typedef std::function< void() > Task;
+
+		// Zero threads means one per hardware thread.
+		explicit ThreadPool(size_t threads = 0)
+			: m_pending(0), m_nextQueue(0), m_stop(false)
+		{
+			if (!threads)
+			{
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			}
+			for (size_t i = 0; i < threads; ++i)
+			{
+				m_queues.emplace_back(new Queue());
+			}
+			for (size_t i = 0; i < threads; ++i)
+			{
+				m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+			}
+		}
+
+		// Runs the tasks still queued, then joins the workers.
+		~ThreadPool()
+		{
+			{
+				std::lock_guard< std::mutex > lock(m_sleepMutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (auto & thread : m_threads)
+			{
+				thread.join();
+			}
+		}
+
+		size_t size() const
+		{
+			return m_threads.size();
+		}
+
+		void submit(Task task)
+		{
+			Worker const & worker = currentWorker();
+			size_t index = worker.pool == this ? worker.index : m_nextQueue++ % m_queues.size();
+			{
+				// counted first, so m_pending never drops below the number of queued tasks
+				std::lock_guard< std::mutex > lock(m_sleepMutex);
+				++m_pending;
+			}
+			{
+				std::lock_guard< std::mutex > lock(m_queues[index]->mutex);
+				m_queues[index]->tasks.push_back(std::move(task));
+			}
+			m_wake.notify_one();
+		}
+
+		// Process-wide pool with one thread per hardware thread.
+		static ThreadPool & shared()
+		{
+			static ThreadPool s_pool;
+			return s_pool;
+		}
+
+	protected:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque< Task > tasks;
+		};
+		struct Worker
+		{
+			ThreadPool * pool;
+			size_t index;
+		};
+
+		static Worker & currentWorker()
+		{
+			static thread_local Worker s_worker = { nullptr, 0 };
+			return s_worker;
+		}
+
+		bool popTask(size_t home, Task & task)
+		{
+			if (!m_pending.load())
+			{
+				return false;
+			}
+			for (size_t i = 0; i < m_queues.size(); ++i)
+			{
+				Queue & queue = *m_queues[(home + i) % m_queues.size()];
+				std::lock_guard< std::mutex > lock(queue.mutex);
+				if (queue.tasks.empty())
+				{
+					continue;
+				}
+				if (!i)
+				{
+					task = std::move(queue.tasks.back());
+					queue.tasks.pop_back();
+				}
+				else
+				{
+					task = std::move(queue.tasks.front());
+					queue.tasks.pop_front();
+				}
+				--m_pending;
+				return true;
+			}
+			return false;
+		}
+
+		void workerLoop(size_t index)
+		{
+			Worker & worker = currentWorker();
+			worker.pool = this;
+			worker.index = index;
+			while (true)
+			{
+				Task task;
+				if (popTask(index, task))
+				{
+					task();
+					continue;
+				}
+				std::unique_lock< std::mutex > lock(m_sleepMutex);
+				if (m_stop && !m_pending)
+				{
+					return;
+				}
+				m_wake.wait(lock, [this]() { return m_stop || m_pending > 0; });
+			}
+		}
+
+	protected:
+		std::vector< std::unique_ptr< Queue > > m_queues;
+		std::vector< std::thread > m_threads;
+		std::atomic< size_t > m_pending;
+		std::atomic< size_t > m_nextQueue;
+		bool m_stop;
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wake;
+	};
+
+
+	// Tasks run on a pool and waited for together. The tasks are queued in the group and
+	// the pool is handed one call per task to run the oldest one left, so the thread
+	// waiting for the group can run them too: waiting never runs tasks of other groups
+	// (which could be other requests) on the waiter's stack, and nested groups can not
+	// deadlock the pool. wait() rethrows the first exception thrown by a task.
+	class TaskGroup
+	{
+	public:
+		TaskGroup(ThreadPool & pool)
+			: m_pool(pool), m_state(std::make_shared< State >())
+		{}
+
+		void run(ThreadPool::Task task)
+		{
+			std::shared_ptr< State > state = m_state;
+			{
+				std::lock_guard< std::mutex > lock(state->mutex);
+				state->queued.push_back(std::move(task));
+				++state->remaining;
+			}
+			// a task adding to its own group wakes the thread waiting for it
+			state->done.notify_all();
+			// the pool may get to it after the group is gone, when it has nothing left to run
+			m_pool.submit([state]()
+			{
+				runQueued(*state);
+			});
+		}
+
+		// Runs one queued task of the group on the calling thread. Returns false if all of
+		// them have been started.
+		bool runPendingTask()
+		{
+			return runQueued(*m_state);
+		}
+
+		void wait()
+		{
+			finish();
+			std::lock_guard< std::mutex > lock(m_state->mutex);
+			if (m_state->error)
+			{
+				std::exception_ptr error = m_state->error;
+				m_state->error = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+
+		~TaskGroup()
+		{
+			finish();
+		}
+
+	protected:
+		struct State
+		{
+			State()
+				: remaining(0)
+			{}
+
+			std::mutex mutex;
+			std::condition_variable done;
+			std::deque< ThreadPool::Task > queued;
+			size_t remaining;
+			std::exception_ptr error;
+		};
+
+		static bool runQueued(State & state)
+		{
+			ThreadPool::Task task;
+			{
+				std::lock_guard< std::mutex > lock(state.mutex);
+				if (state.queued.empty())
+				{
+					return false;
+				}
+				task = std::move(state.queued.front());
+				state.queued.pop_front();
+			}
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				std::lock_guard< std::mutex > lock(state.mutex);
+				if (!state.error)
+				{
+					state.error = std::current_exception();
+				}
+			}
+			std::lock_guard< std::mutex > lock(state.mutex);
+			if (!--state.remaining)
+			{
+				state.done.notify_all();
+			}
+			return true;
+		}
+
+		// Runs what is still queued, then waits for the tasks started by other threads.
+		void finish()
+		{
+			State & state = *m_state;
+			while (true)
+			{
+				while (runQueued(state))
+				{}
+				std::unique_lock< std::mutex > lock(state.mutex);
+				state.done.wait(lock, [&state]() { return !state.remaining || state.queued.size(); });
+				if (!state.remaining)
+				{
+					return;
+				}
+			}
+		}
+
+	protected:
+		ThreadPool & m_pool;
+		std::shared_ptr< State > m_state;
+	};
+
+} /* namespace RedZone */